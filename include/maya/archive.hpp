@@ -0,0 +1,147 @@
+#pragma once
+
+#include "./dataio.hpp"
+
+namespace maya
+{
+
+// Kinds of asset stored in an archive.
+enum AssetType
+{
+	RAW_ASSET,					// Bytes as given.
+	IMAGE_ASSET,				// 8-bit pixels, rows from bottom to top.
+	COMPRESSED_IMAGE_ASSET,		// Block compressed levels, ready for upload.
+	AUDIO_ASSET,				// Interleaved samples, float or encoded as the storage in the layout.
+	FONT_ASSET,					// Font file, rasterized on import.
+};
+
+// Read only package of many assets in one memory mapped file.
+// The table of contents is parsed once at open, assets are then located without any file access.
+// Blobs are aligned to 64 bytes and optionally compressed in independent LZ4 chunks.
+class AssetArchive
+{
+public:
+
+	// Table of contents entry.
+	struct Entry
+	{
+		// Unique name of the asset.
+		stl::string Name;
+
+		// Kind of asset.
+		AssetType Type;
+
+		// True if the blob is LZ4 compressed.
+		bool Compressed;
+
+		// Location of the blob in the file, and its size once decompressed.
+		MAYA_STL size_t Offset, StoredSize, Size;
+
+		// Type specific layout, e.g. width, height and channels of an image.
+		int Layout[4];
+	};
+
+	// Nothing opened.
+	AssetArchive() = default;
+
+	// No copy construct.
+	AssetArchive(AssetArchive const&) = delete;
+	AssetArchive& operator=(AssetArchive const&) = delete;
+
+	// Map the archive and read its table of contents, returns false on failure.
+	bool Open(char const* path);
+
+	// Unmap the archive, imported images keep the mapping alive until released.
+	void Close();
+
+	// Returns true if an archive is opened.
+	inline bool IsOpen() const { return file != 0; }
+
+	// Returns the index of the named asset, or -1 if absent.
+	int Find(stl::strview name) const;
+
+	// Returns the entry of an asset.
+	inline Entry const& GetEntry(int index) const { return entries[index]; }
+
+	// Returns the number of assets.
+	inline int GetEntryCount() const { return static_cast<int>(entries.size()); }
+
+	// Returns the blob of an uncompressed asset in the mapped memory, or empty if compressed.
+	ConstBuffer<void> GetView(int index) const;
+
+	// Copy the asset into dst of Entry::Size bytes, decompressing chunks in parallel.
+	bool Read(int index, void* dst) const;
+
+	// Hint the system to load the blob of an asset ahead of import.
+	void Prefetch(int index) const;
+
+	// Shared mapping, for memory adopted from the archive.
+	inline stl::sptr<MappedFile> const& GetFile() const { return file; }
+
+private:
+
+	stl::sptr<MappedFile> file;
+	stl::list<Entry> entries;
+	stl::hashmap<stl::strview, int> lookup;
+};
+
+// Builds an archive from assets in memory, written out in one pass.
+class AssetArchiveWriter
+{
+public:
+
+	// Add pixels of an 8-bit image.
+	void Add(char const* name, ImageData const& image, bool compress = false);
+
+	// Add every level of a block compressed image.
+	void Add(char const* name, CompressedImageData const& image, bool compress = false);
+
+	// Add samples of audio data.
+	void Add(char const* name, AudioData const& audio, bool compress = false);
+
+	// Add a font file, which is rasterized on import.
+	void AddFont(char const* name, char const* path, bool compress = false);
+
+	// Add bytes as they are.
+	void AddRaw(char const* name, ConstBuffer<void> data, bool compress = false);
+
+	// Write the archive, chunks are compressed in parallel. Returns false on failure.
+	bool Write(char const* path, unsigned threads = 0) const;
+
+private:
+
+	struct Blob
+	{
+		stl::string Name;
+		AssetType Type;
+		bool Compress;
+		int Layout[4];
+		stl::list<unsigned char> Data;
+	};
+
+	stl::list<Blob> blobs;
+
+	void Push(char const* name, AssetType type, bool compress, int const* layout, void const* data, MAYA_STL size_t size);
+};
+
+// Disk cache of processed assets beneath the file Import functions of ImageData, FontData and AudioData.
+// Entries are addressed by a hash of the source content and import parameters, each stored as an archive.
+// A source is only hashed again when its size or modification time changes.
+class AssetCache
+{
+public:
+
+	// Enable the cache in a directory, created if absent. Null or empty disables it, which is the default.
+	static void SetDirectory(char const* path);
+
+	// Returns the cache directory, empty if disabled.
+	static stl::string GetDirectory();
+
+	// Open the cached form of a source file processed with params, returns false on miss.
+	static bool Load(char const* path, uint64_t params, AssetArchive& archive);
+
+	// Store the processed form of a source file.
+	static void Store(char const* path, uint64_t params, AssetArchiveWriter const& writer);
+};
+
+}
@@ -2,6 +2,8 @@
 
 #include "./core.hpp"
 #include "./math.hpp"
+#include <deque>
+#include <condition_variable>
 
 namespace maya
 {
@@ -40,4 +42,47 @@ private:
 	void CompleteWorks();
 };
 
+// Fixed pool of threads running queued jobs in order of submission.
+class ThreadPool
+{
+public:
+
+	// Start the threads, 0 for hardware concurrency.
+	ThreadPool(unsigned threads = 0);
+
+	// Finish queued jobs and join the threads.
+	~ThreadPool();
+
+	// No copy construct.
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	// Queue a job, thread safe.
+	void Submit(stl::fnptr<void()> job);
+
+	// Block until every queued job has finished, including jobs they submit.
+	void Wait();
+
+	// Returns the number of threads.
+	inline unsigned GetThreadCount() const { return static_cast<unsigned>(threads.size()); }
+
+	// Returns the number of jobs queued or running.
+	unsigned GetPendingCount() const;
+
+private:
+
+	stl::list<MAYA_STL thread> threads;
+	MAYA_STL deque<stl::fnptr<void()>> jobs;
+	mutable MAYA_STL mutex mutex;
+	MAYA_STL condition_variable wake, idle;
+	unsigned pending;
+	bool stop;
+
+	void Run();
+};
+
+// Execute fn(begin, end) over [0, count) split among threads, blocks until done.
+// Ranges smaller than grain are not worth a thread. 0 threads for hardware concurrency.
+void ParallelFor(int count, unsigned threads, stl::fnptr<void(int, int)> const& fn, int grain = 32);
+
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "./texture.hpp"
+
+namespace maya
+{
+
+// Packs many images into a few textures, so that they can be drawn with one binding.
+// Uses MaxRects with best short side fit, a new page is added when one is full.
+class TextureAtlas
+{
+public:
+
+	using uptr = stl::uptr<TextureAtlas>;
+	using sptr = stl::sptr<TextureAtlas>;
+
+	// Location of an inserted image.
+	struct Region
+	{
+		// Index of the page texture.
+		int Page;
+
+		// Pixel rectangle in the page, excluding padding.
+		Ivec2 Position, Size;
+
+		// Texture coordinates of the rectangle.
+		Fvec2 UvMin, UvMax;
+	};
+
+	// Constructor, padding pixels around each image are filled with its edges.
+	TextureAtlas(RenderContext& rc, Ivec2 pagesize = { 2048, 2048 }, int channels = 4, int padding = 1);
+
+	// No copy construct.
+	TextureAtlas(TextureAtlas const&) = delete;
+	TextureAtlas& operator=(TextureAtlas const&) = delete;
+
+	// Create and return a uptr.
+	static uptr MakeUnique(RenderContext& rc, Ivec2 pagesize = { 2048, 2048 }, int channels = 4, int padding = 1);
+
+	// Create and return a sptr.
+	static sptr MakeShared(RenderContext& rc, Ivec2 pagesize = { 2048, 2048 }, int channels = 4, int padding = 1);
+
+	// Insert an 8-bit image and return its id, or -1 if it is empty or larger than a page.
+	int Insert(struct ImageData const& image);
+
+	// Insert images largest first for tighter packing, ids are returned in the given order.
+	stl::list<int> Insert(stl::list<struct ImageData> const& images);
+
+	// Get the region of an inserted image.
+	inline Region const& GetRegion(int id) const { return regions[id]; }
+
+	// Get the number of inserted images.
+	inline int GetRegionCount() const { return static_cast<int>(regions.size()); }
+
+	// Get a page texture.
+	inline Texture& GetPage(int page) { return *pages[page].Tex; }
+
+	// Get the number of pages.
+	inline int GetPageCount() const { return static_cast<int>(pages.size()); }
+
+private:
+
+	struct Rect { int X, Y, W, H; };
+
+	struct Page {
+		Texture::uptr Tex;
+		stl::list<Rect> FreeRects;
+	};
+
+	RenderContext* rc;
+	Ivec2 pagesize;
+	int channels, padding;
+	stl::list<Page> pages;
+	stl::list<Region> regions;
+
+	bool FindPosition(Page const& page, int w, int h, Rect& out) const;
+	void PlaceRect(Page& page, Rect const& rect);
+	void AddPage();
+};
+
+}
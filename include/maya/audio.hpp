@@ -5,7 +5,140 @@
 namespace maya
 {
 
+// Timing of the callback of an output, collected on the audio thread without locks.
+struct AudioStats
+{
+	// Callbacks by time taken as a fraction of the buffer duration, in steps of 1 / 16.
+	// Bins from 16 on missed the deadline, and the last also counts every longer callback.
+	static constexpr unsigned LoadBins = 32;
+	stl::array<MAYA_STL uint64_t, LoadBins> Load;
+
+	// Number of callbacks, and of buffers the device reported as underflowed (heard as a gap) or overflowed.
+	MAYA_STL uint64_t Callbacks, Underflows, Overflows;
+
+	// Average and longest callback time, and the duration of the last buffer, in microseconds.
+	float AverageTime, MaxTime, BufferTime;
+
+	// Load that the fraction p of callbacks stay within, to the step of the bins.
+	float GetLoadPercentile(float p) const;
+};
+
+// Output stream of a player or a mixer.
+// On the device backend the callback runs on the audio thread of the sound card.
+// On the offline backend no device is needed, and the callback runs within Render as fast as possible,
+// for machines without a sound card, deterministic tests and throughput benchmarks.
+class AudioOutput
+{
+public:
+
+	// Fill frames interleaved float frames, returns false once the source has ended.
+	using Callback = bool(*)(void* userdata, float* out, unsigned frames);
+
+	enum Backend { DEVICE_BACKEND, OFFLINE_BACKEND };
+
+	// Select the backend of outputs opened from now on, by default the device.
+	static void SetBackend(Backend backend);
+
+	// Retrieve the backend of outputs opened from now on.
+	static Backend GetBackend();
+
+	// Constructor, not opened.
+	AudioOutput();
+
+	// Close the output.
+	~AudioOutput();
+
+	// No copy construct.
+	AudioOutput(AudioOutput const&) = delete;
+	AudioOutput& operator=(AudioOutput const&) = delete;
+
+	// Open on the current backend, stopped. Returns false if no device is available.
+	bool Open(unsigned channels, unsigned samplerate, unsigned framesperbuffer, Callback callback, void* userdata);
+
+	// Close the output, the callback is not called afterwards.
+	void Close();
+
+	// Start calling the callback.
+	void Start();
+
+	// Stop calling the callback, after the current buffer.
+	void Stop();
+
+	// Check if the output is opened.
+	bool IsOpen() const;
+
+	// Check if started and the source has not ended.
+	bool IsActive() const;
+
+	// Check if the callback may be running on another thread right now.
+	// Offline outputs render on the calling thread, so they never are.
+	bool IsConcurrent() const;
+
+	// Offline only: run the callback for up to frames frames, in buffers of frames per buffer.
+	// Returns the number of frames rendered, less than requested if the source has ended or not started.
+	unsigned Render(float* out, unsigned frames);
+
+	// Offline only: render up to frames frames into a 32-bit float WAV file, stopping early if the source ends.
+	bool RenderToFile(char const* path, MAYA_STL uint64_t frames);
+
+	// Backend the output is opened on.
+	inline Backend GetOutputBackend() const { return backend; }
+
+	// Number of interleaved channels.
+	inline unsigned GetChannels() const { return channels; }
+
+	// Sample rate in Hz.
+	inline unsigned GetSampleRate() const { return samplerate; }
+
+	// Frames per buffer.
+	inline unsigned GetFramesPerBuffer() const { return framesperbuffer; }
+
+	// Timing of the callback since the output was opened or the stats were reset, callable from any thread.
+	AudioStats GetStats() const;
+
+	// Clear the stats.
+	void ResetStats();
+
+	// Size the buffers of the device to the machine instead of the frames per buffer asked for.
+	// The output starts at the lowest latency the device reports, and Adapt moves between powers of two
+	// up to maxframes, growing on underflows or late callbacks and shrinking after ten stable seconds.
+	// A size that underflowed is not returned to until adapting is enabled again.
+	void SetAdaptive(bool adaptive, unsigned maxframes = 0x1000);
+
+	// Check if the buffers are sized adaptively.
+	inline bool IsAdaptive() const { return adaptive; }
+
+	// Review the stats and reopen the device at a new buffer size if needed, playing on after a short gap.
+	// Call regularly from the thread controlling the output, such as once per frame.
+	// Returns true if the buffer size changed.
+	bool Adapt();
+
+private:
+
+	friend struct AudioOutputDevice;
+
+	void* nativeptr;
+	Backend backend;
+	Callback callback;
+	void* userdata;
+	unsigned channels, samplerate, framesperbuffer;
+	stl::atomic<bool> active;
+	stl::uptr<struct AudioOutputCounters> counters;
+
+	// Adaptive sizing, the frames to open at, the smallest size allowed, and the stats at the start of the window.
+	bool adaptive;
+	unsigned adaptframes, minframes, maxframes;
+	AudioStats mark;
+
+	// Open the device stream for the current layout.
+	bool OpenDevice();
+
+	// Run the callback, timing it and counting the reported faults.
+	bool Run(float* out, unsigned frames, bool underflow, bool overflow);
+};
+
 // Play audio source on another thread.
+// Changes are sent to the audio callback through a lock free queue, so call from one thread.
 class AudioPlayer
 {
 public:
@@ -22,12 +155,21 @@ public:
 
 	// Set an audio source for the player to play.
 	// One should not modify the source after this call.
-	// Frames Per Buffer indicates the size of a buffer for each frame.
+	// Frames Per Buffer indicates the size of a buffer for each frame, unless the output is adaptive.
+	// A source with the same channels and sample rate is swapped in without reopening the device,
+	// playing on from its start, and the previous source is released once this returns.
 	void SetSource(struct AudioData const* src, unsigned framesperbuffer = 0x200);
 
+	// Set a stream decoded while playing as the source, which must outlive the player.
+	// A stream that failed to open is rejected, leaving the current source playing.
+	void SetSource(class AudioStream* src, unsigned framesperbuffer = 0x200);
+
 	// Return the cuurent audio source, or nullptr if none.
 	struct AudioData const* GetSource() const;
 
+	// Return the current stream source, or nullptr if none.
+	class AudioStream* GetStream() const;
+
 	// Get the frames per buffer.
 	unsigned GetFramesPerBuffer() const;
 
@@ -43,6 +185,14 @@ public:
 	// pos indicates the seconds to start with.
 	void Start(float pos = 0);
 
+	// Volume changes and seeks sent after this call apply at the output frame, 0 for as soon as possible.
+	// Commands apply in the order sent, so a later time holds back the commands after it.
+	// Changing the source is never timed, and the commands sent before it apply first.
+	void SetCommandTime(MAYA_STL uint64_t frame);
+
+	// Number of frames sent to the output so far, the time base of SetCommandTime.
+	MAYA_STL uint64_t GetClock() const;
+
 	// Resume where the player has stopped.
 	// Would not interrupt if the audio is playing.
 	void Resume();
@@ -56,15 +206,21 @@ public:
 	// Get the current playing position in seconds.
 	float GetPosition() const;
 
-	// Get the duration of the audio track.
+	// Get the duration of the audio track, 0 for a stream not yet measured.
 	float GetDuration() const;
 
 	// Check whether the end is reached.
 	bool IsEndReached() const;
 
+	// Timing of the audio callback, for tuning the frames per buffer.
+	inline AudioStats GetStats() const { return output.GetStats(); }
+
+	// Output stream of the player, for offline rendering.
+	inline AudioOutput& GetOutput() { return output; }
+
 private:
 
-	void* nativeptr;
+	AudioOutput output;
 	stl::uptr<struct AudioStatus> status;
 };
 
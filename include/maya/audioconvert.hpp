@@ -0,0 +1,57 @@
+#pragma once
+
+#include "./core.hpp"
+
+namespace maya
+{
+
+// Layout of one PCM sample, little endian.
+// 8-bit samples are unsigned as stored in WAV files, the others are signed or IEEE float.
+enum SampleFormat
+{
+	U8_SAMPLE,
+	S8_SAMPLE,
+	S16_SAMPLE,
+	S24_SAMPLE,
+	S32_SAMPLE,
+	F32_SAMPLE,
+	F64_SAMPLE
+};
+
+// Size of one sample of the format in bytes.
+unsigned GetSampleSize(SampleFormat format);
+
+// Convert count samples to float in [-1, 1), the source may be unaligned.
+// Integers are scaled by 2^(1 - bits), so every integer maps back to itself.
+void ConvertToFloat(float* dst, void const* src, SampleFormat format, MAYA_STL size_t count);
+
+// Convert count float samples to the format, rounded to nearest and clamped, the destination may be unaligned.
+void ConvertFromFloat(void* dst, float const* src, SampleFormat format, MAYA_STL size_t count);
+
+// Interleave frames of separate channel buffers into one buffer.
+void InterleaveSamples(float* dst, float const* const* src, unsigned channels, MAYA_STL size_t frames);
+
+// Split interleaved frames into separate channel buffers.
+void DeinterleaveSamples(float* const* dst, float const* src, unsigned channels, MAYA_STL size_t frames);
+
+// Convert interleaved frames to another number of channels, dst and src must not overlap.
+// Mono is copied to every channel, and any layout averages down to mono.
+// 5.1 (FL FR C LFE SL SR) is downmixed to stereo with the ITU coefficients.
+// Other layouts keep the channels they share, and added channels are silent.
+void RemixChannels(float* dst, unsigned dstchannels, float const* src, unsigned srcchannels, MAYA_STL size_t frames);
+
+// IMA ADPCM stores 4 bits per sample, in blocks of one channel headed by the decoder state.
+// Blocks decode independently, so playback can start at any block and several blocks decode at once.
+constexpr unsigned AdpcmBlockFrames = 64;
+constexpr unsigned AdpcmBlockSize = 36;
+
+// Bytes needed to encode frames, the last block is padded with silence.
+MAYA_STL size_t GetAdpcmSize(unsigned channels, MAYA_STL size_t frames);
+
+// Encode interleaved frames, the blocks of every channel are stored together for each 64 frames.
+void EncodeAdpcm(void* dst, float const* src, unsigned channels, MAYA_STL size_t frames);
+
+// Decode count frames from frame first to interleaved float, the frames must have been encoded.
+void DecodeAdpcm(float* dst, void const* src, unsigned channels, MAYA_STL size_t first, MAYA_STL size_t count);
+
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "./dataio.hpp"
+#include "./audioconvert.hpp"
+
+namespace maya
+{
+
+// Lock free ring of samples between one producer thread and one consumer thread.
+// Positions are absolute sample counts, so they never wrap in practice.
+class SampleRing
+{
+public:
+
+	// Capacity is rounded up to a power of two.
+	SampleRing(MAYA_STL size_t capacity);
+
+	// No copy construct.
+	SampleRing(SampleRing const&) = delete;
+	SampleRing& operator=(SampleRing const&) = delete;
+
+	// Producer: append up to count samples, returns the number appended.
+	MAYA_STL size_t Write(float const* samples, MAYA_STL size_t count);
+
+	// Consumer: take up to count samples, returns the number taken.
+	MAYA_STL size_t Read(float* samples, MAYA_STL size_t count);
+
+	// Consumer: drop every sample before the position, which must not be ahead of the producer.
+	void SkipTo(MAYA_STL uint64_t position);
+
+	// Number of samples ready for the consumer.
+	inline MAYA_STL size_t GetReadable() const { return static_cast<MAYA_STL size_t>(write.load(MAYA_STL memory_order_acquire) - read.load(MAYA_STL memory_order_relaxed)); }
+
+	// Number of samples the producer can append.
+	inline MAYA_STL size_t GetWritable() const { return buffer.size() - static_cast<MAYA_STL size_t>(write.load(MAYA_STL memory_order_relaxed) - read.load(MAYA_STL memory_order_acquire)); }
+
+	// Producer: position of the next sample written.
+	inline MAYA_STL uint64_t GetWritePosition() const { return write.load(MAYA_STL memory_order_relaxed); }
+
+	// Returns the capacity in samples.
+	inline MAYA_STL size_t GetCapacity() const { return buffer.size(); }
+
+private:
+
+	stl::list<float> buffer;
+	MAYA_STL size_t mask;
+	alignas(64) stl::atomic<MAYA_STL uint64_t> write;
+	alignas(64) stl::atomic<MAYA_STL uint64_t> read;
+};
+
+// A change to playback, sent from the API and applied by the audio callback.
+struct AudioCommand
+{
+	enum Type { PLAY, STOP, SEEK, SET_GAIN, SET_PAN, SET_SOURCE };
+
+	Type Kind;
+
+	// Output frame at which to apply, a command already due applies at the start of the next buffer.
+	MAYA_STL uint64_t Frame;
+
+	// Voice of a mixer, unused by a player.
+	unsigned Voice;
+
+	// Gain and pan, and the frame to seek to.
+	float Gain, Pan;
+	MAYA_STL uint64_t Position;
+
+	// Source to play or swap to.
+	struct AudioData const* Data;
+	class AudioStream* Stream;
+	bool Loop;
+
+	// Converts the source to the output rate, or nullptr if the rates match.
+	class Resampler* Resample;
+};
+
+// Lock free queue of commands from one producer thread to the audio callback.
+// Storage is allocated once, so neither side allocates or blocks.
+class AudioCommandQueue
+{
+public:
+
+	// Capacity is rounded up to a power of two.
+	AudioCommandQueue(MAYA_STL size_t capacity);
+
+	// No copy construct.
+	AudioCommandQueue(AudioCommandQueue const&) = delete;
+	AudioCommandQueue& operator=(AudioCommandQueue const&) = delete;
+
+	// Producer: append a command, returns false if full.
+	bool Push(AudioCommand const& command);
+
+	// Consumer: returns the oldest command, or nullptr if empty.
+	AudioCommand const* Peek() const;
+
+	// Consumer: remove the oldest command.
+	void Pop();
+
+private:
+
+	stl::list<AudioCommand> buffer;
+	MAYA_STL size_t mask;
+	alignas(64) stl::atomic<MAYA_STL uint64_t> write;
+	alignas(64) stl::atomic<MAYA_STL uint64_t> read;
+};
+
+// Source of audio produced while playing, read from the audio callback.
+class AudioStream
+{
+public:
+
+	virtual ~AudioStream() = default;
+
+	// Called on the audio thread, must not block or allocate.
+	// Copy up to frames interleaved frames into out, returns the number copied.
+	virtual unsigned Read(float* out, unsigned frames) = 0;
+
+	// Move the read position to a frame, thread safe.
+	virtual void Seek(MAYA_STL uint64_t frame) = 0;
+
+	// Returns the frame to be read next.
+	virtual MAYA_STL uint64_t GetPosition() const = 0;
+
+	// Returns the number of frames, or 0 if not known yet.
+	virtual MAYA_STL uint64_t GetFrameCount() const = 0;
+
+	// Returns true if every frame has been read.
+	virtual bool IsEndReached() const = 0;
+
+	// Sample rate in Hz.
+	inline unsigned GetSampleRate() const { return samplerate; }
+
+	// Number of channels.
+	inline unsigned GetChannels() const { return channels; }
+
+protected:
+
+	unsigned samplerate = 0, channels = 0;
+};
+
+// Decodes an mp3 file on a background thread while playing.
+// Frames are decoded from the memory mapped file into a ring a fraction of a second long,
+// so memory stays small and constant regardless of the track length.
+class Mp3Stream : public AudioStream
+{
+public:
+
+	// Open the file and start decoding, buffering up to buffertime seconds ahead.
+	Mp3Stream(char const* path, float buffertime = 0.5f);
+
+	// Stop the decoding thread.
+	~Mp3Stream();
+
+	// No copy construct.
+	Mp3Stream(Mp3Stream const&) = delete;
+	Mp3Stream& operator=(Mp3Stream const&) = delete;
+
+	// Returns true if the file is opened and decodable.
+	inline bool IsOpen() const { return ring != 0; }
+
+	virtual unsigned Read(float* out, unsigned frames) override;
+	virtual void Seek(MAYA_STL uint64_t frame) override;
+	virtual MAYA_STL uint64_t GetPosition() const override;
+	virtual MAYA_STL uint64_t GetFrameCount() const override;
+	virtual bool IsEndReached() const override;
+
+private:
+
+	MappedFile file;
+	stl::uptr<SampleRing> ring;
+	MAYA_STL thread thread;
+	stl::atomic<bool> running, eof;
+	stl::atomic<MAYA_STL uint64_t> framecount, position;
+
+	// A seek is requested by bumping seekrequest. The decoder marks where the new data starts in the ring
+	// and publishes it as seekserved, the callback then skips to the mark.
+	stl::atomic<unsigned> seekrequest, seekserved;
+	stl::atomic<MAYA_STL uint64_t> seekframe, seekmark, seekmarkframe;
+	stl::atomic<unsigned> seekapplied;
+
+	void Decode();
+};
+
+// Layout of the samples in a WAV file.
+struct WavFormat
+{
+	// 1 for integer PCM, 3 for IEEE float.
+	unsigned Encoding;
+
+	// Number of channels and sample rate in Hz.
+	unsigned Channels, SampleRate;
+
+	// Bits of each sample, and bytes of each frame of all channels.
+	unsigned BitsPerSample, BlockAlign;
+
+	// Location of the sample data in the file.
+	MAYA_STL size_t DataOffset, DataSize;
+
+	// Parse the RIFF chunks of a WAV file in memory, returns false with a reason if unsupported.
+	bool Parse(ConstBuffer<void> file, stl::string& reason);
+
+	// Layout of each sample, once parsed.
+	SampleFormat GetSampleFormat() const;
+};
+
+// Plays a WAV file from memory mapping, samples are converted to float as they are read.
+// Memory stays at the bit depth of the file, and opening does not depend on the track length.
+// A background thread asks the system to read ahead of the playing position.
+class WavStream : public AudioStream
+{
+public:
+
+	// Map the file and parse its chunks.
+	WavStream(char const* path);
+
+	// Stop the readahead thread.
+	~WavStream();
+
+	// No copy construct.
+	WavStream(WavStream const&) = delete;
+	WavStream& operator=(WavStream const&) = delete;
+
+	// Returns true if the file is opened and supported.
+	inline bool IsOpen() const { return file.IsOpen(); }
+
+	// Wrap around to the start at the end, for ambience loops.
+	inline void SetLooping(bool loop) { looping = loop; }
+
+	// Returns true if looping.
+	inline bool IsLooping() const { return looping; }
+
+	virtual unsigned Read(float* out, unsigned frames) override;
+	virtual void Seek(MAYA_STL uint64_t frame) override;
+	virtual MAYA_STL uint64_t GetPosition() const override;
+	virtual MAYA_STL uint64_t GetFrameCount() const override;
+	virtual bool IsEndReached() const override;
+
+private:
+
+	MappedFile file;
+	WavFormat format;
+	MAYA_STL uint64_t framecount;
+	stl::atomic<MAYA_STL uint64_t> position, seekframe;
+	stl::atomic<bool> looping, seeking;
+
+	// Byte of the data the callback reads next, prefetched ahead by the thread.
+	MAYA_STL thread thread;
+	stl::atomic<bool> running;
+	stl::atomic<MAYA_STL size_t> wanted;
+
+	void Prefetch();
+};
+
+}
@@ -6,11 +6,98 @@
 namespace maya
 {
 
+// Whole file mapped read only into memory, pages are loaded on first access.
+// Pages are copy on write, so writes through the view are never reflected to the file.
+class MappedFile
+{
+public:
+
+	// Nothing mapped.
+	MappedFile() = default;
+
+	// Unmap the file.
+	~MappedFile();
+
+	// No copy construct.
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	// Map the file, returns false on failure.
+	bool Open(char const* path);
+
+	// Unmap the file.
+	void Close();
+
+	// Hint the system to read a range ahead of access.
+	void Prefetch(MAYA_STL size_t offset, MAYA_STL size_t size) const;
+
+	inline bool IsOpen() const { return ptr != 0; }
+	inline unsigned char* GetData() const { return ptr; }
+	inline MAYA_STL size_t GetSize() const { return size; }
+
+private:
+
+	unsigned char* ptr = 0;
+	MAYA_STL size_t size = 0;
+};
+
+// Byte storage of images, which can adopt memory from elsewhere without copying,
+// e.g. a decoder allocation or a memory mapped file, released by a custom deleter.
+// Interface follows stl::list so that it can be used in place.
+class ImageBuffer
+{
+public:
+
+	// Empty buffer.
+	ImageBuffer() = default;
+
+	// Release adopted memory.
+	~ImageBuffer();
+
+	// Copy into owned memory.
+	ImageBuffer(ImageBuffer const& other);
+	ImageBuffer& operator=(ImageBuffer const& other);
+
+	// Move without copying.
+	ImageBuffer(ImageBuffer&& other) noexcept;
+	ImageBuffer& operator=(ImageBuffer&& other) noexcept;
+
+	// Take ownership of memory, deleter is called on release.
+	void Adopt(unsigned char* data, MAYA_STL size_t size, stl::fnptr<void(unsigned char*)> deleter);
+
+	// Returns true if the memory is adopted rather than owned.
+	inline bool IsAdopted() const { return static_cast<bool>(deleter); }
+
+	// Resize into owned memory, existing bytes are kept.
+	void resize(MAYA_STL size_t size);
+
+	// Release the memory.
+	void clear();
+
+	inline unsigned char* data() { return ptr; }
+	inline unsigned char const* data() const { return ptr; }
+	inline MAYA_STL size_t size() const { return count; }
+	inline bool empty() const { return !count; }
+	inline unsigned char* begin() { return ptr; }
+	inline unsigned char* end() { return ptr + count; }
+	inline unsigned char const* begin() const { return ptr; }
+	inline unsigned char const* end() const { return ptr + count; }
+	inline unsigned char& operator[](MAYA_STL size_t i) { return ptr[i]; }
+	inline unsigned char const& operator[](MAYA_STL size_t i) const { return ptr[i]; }
+
+private:
+
+	unsigned char* ptr = 0;
+	MAYA_STL size_t count = 0;
+	stl::list<unsigned char> owned;
+	stl::fnptr<void(unsigned char*)> deleter;
+};
+
 // Stores image data.
 struct ImageData
 {
-	// Uncompressed byte image data.
-	stl::list<unsigned char> Data;
+	// Uncompressed byte image data, rows from bottom to top.
+	ImageBuffer Data;
 
 	// Image dimension.
 	Ivec2 Size;
@@ -19,9 +106,98 @@ struct ImageData
 	int Channels;
 
 	// Import image data from file.
+	// The decoded pixels are adopted without copying.
 	void Import(char const* path, int channels = 0);
+
+	// Decode an image file in memory, returns false on failure without reporting an error.
+	// Safe to call from any thread.
+	bool Decode(ConstBuffer<void> file, int channels = 0);
+
+	// Map a file of raw 8-bit pixels into memory, starting at offset bytes.
+	// Pages are loaded on access and writes are not reflected to the file.
+	void Map(char const* path, Ivec2 size, int channels, MAYA_STL size_t offset = 0);
+
+	// Import from an archive, uncompressed pixels are adopted from the mapping without copying.
+	void Import(class AssetArchive const& archive, char const* name);
 };
 
+// Imports many image files in parallel.
+struct ImageBatchData
+{
+	// Images in the order of the paths, empty if failed.
+	stl::list<ImageData> Images;
+
+	// Elapsed seconds of the whole import.
+	float WallTime;
+
+	// Seconds from queueing each read to its completion, and seconds spent decoding, summed over files.
+	float ReadTime, DecodeTime;
+
+	// Total size of the files read.
+	MAYA_STL size_t FileBytes;
+
+	// Number of images failed to import.
+	unsigned FailedCount;
+
+	// Import the files, decoding on threads while later reads are in flight, 0 for hardware concurrency.
+	void Import(stl::list<stl::string> const& paths, int channels = 0, unsigned threads = 0);
+};
+
+// Filters available for downsampling mipmaps.
+enum MipmapFilter
+{
+	BOX_FILTER,
+	KAISER_FILTER,
+};
+
+// Stores a full mipmap chain, where level 0 is the base image.
+struct MipmapData
+{
+	// Images of each level, halved in size until 1x1.
+	stl::list<ImageData> Levels;
+
+	// Generate the chain from an 8-bit image.
+	// Rows of each level are split among threads, 0 for hardware concurrency.
+	void Generate(ImageData const& base, MipmapFilter filter = BOX_FILTER, unsigned threads = 0);
+};
+
+// Block compressed formats, each block covers 4x4 pixels.
+enum CompressedFormat
+{
+	BC1_FORMAT, // RGB, 8 bytes per block.
+	BC3_FORMAT, // RGBA, 16 bytes per block.
+	BC4_FORMAT, // Red, 8 bytes per block.
+	BC5_FORMAT, // Red and green, 16 bytes per block.
+};
+
+// Stores block compressed image data.
+struct CompressedImageData
+{
+	// Compressed blocks of each mipmap level, level 0 first.
+	stl::list<stl::list<unsigned char>> Levels;
+
+	// Dimension of level 0.
+	Ivec2 Size;
+
+	// Format of the blocks.
+	CompressedFormat Format;
+
+	// Import from a DDS or KTX (version 1) file.
+	void Import(char const* path);
+
+	// Import from an archive.
+	void Import(class AssetArchive const& archive, char const* name);
+
+	// Compress an 8-bit image, block rows are split among threads.
+	void Encode(ImageData const& image, CompressedFormat format, unsigned threads = 0);
+
+	// Compress every level of a mipmap chain.
+	void Encode(MipmapData const& mipmaps, CompressedFormat format, unsigned threads = 0);
+};
+
+// Bytes of a mipmap level of a block compressed image, size is of level 0.
+MAYA_STL size_t GetCompressedLevelSize(CompressedFormat format, Ivec2 size, unsigned level);
+
 // Stores font data.
 struct FontData
 {
@@ -41,14 +217,34 @@ struct FontData
 
 	// Import font data from memory.
 	void Import(ConstBuffer<void> data, int pixelsize, class RenderContext& rc);
+
+	// Import font data from an archive.
+	void Import(class AssetArchive const& archive, char const* name, int pixelsize, class RenderContext& rc);
+};
+
+// How AudioData keeps its samples in memory.
+enum AudioStorage
+{
+	FLOAT_STORAGE,		// Samples as 32-bit float.
+	INT16_STORAGE,		// Encoded as 16-bit integer, half the memory.
+	ADPCM_STORAGE		// Encoded as IMA ADPCM, 4.5 bits per sample with block headers.
 };
 
 // Stores audio data.
 struct AudioData
 {
-	// Sample data
+	// Sample data, when stored as float.
 	stl::list<float> Samples;
 
+	// Sample data, when stored as int16 or ADPCM.
+	stl::list<unsigned char> Encoded;
+
+	// Number of frames in Encoded.
+	MAYA_STL size_t EncodedFrames = 0;
+
+	// How the samples are stored, by default is FLOAT_STORAGE.
+	AudioStorage Storage = FLOAT_STORAGE;
+
 	// Sample Rate in Hz
 	unsigned SampleRate;
 
@@ -57,7 +253,23 @@ struct AudioData
 
 	// Read audio source from a audio file.
 	// Support WAV and MP3 loading.
-	void Import(char const* path);
+	// Samples are remixed to channels if not 0, otherwise the channels of the file are kept.
+	// Samples are resampled to samplerate at high quality if not 0, such as to the rate of the output device.
+	void Import(char const* path, unsigned channels = 0, unsigned samplerate = 0);
+
+	// Import decoded samples from an archive.
+	void Import(class AssetArchive const& archive, char const* name);
+
+	// Convert the samples to another storage, releasing the memory of the previous one.
+	// Encoding is lossy: int16 is transparent, ADPCM can be heard on quiet or bright material.
+	void SetStorage(AudioStorage storage);
+
+	// Number of frames, whichever the storage.
+	MAYA_STL size_t GetFrameCount() const;
+
+	// Convert up to count frames from frame first to interleaved float, returns the number converted.
+	// Does not allocate, so may be called from the audio callback.
+	MAYA_STL size_t Decode(float* out, MAYA_STL size_t first, MAYA_STL size_t count) const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "./async.hpp"
+
+namespace maya
+{
+
+// Reads whole files asynchronously with many reads in flight at once.
+// On Linux the reads are batched through io_uring, otherwise a pool of threads reads with pread.
+// Completions are handed to a thread pool, so that decoding overlaps with pending reads.
+class AsyncFileReader
+{
+public:
+
+	// Called with the file content when a read completes, ok is false if the file cannot be read.
+	using Callback = stl::fnptr<void(stl::list<unsigned char>& data, bool ok)>;
+
+	// Up to depth reads are in flight, completions run on the pool, or on the I/O thread if null.
+	AsyncFileReader(ThreadPool* pool = 0, unsigned depth = 64);
+
+	// Finish queued reads and their completions.
+	~AsyncFileReader();
+
+	// No copy construct.
+	AsyncFileReader(AsyncFileReader const&) = delete;
+	AsyncFileReader& operator=(AsyncFileReader const&) = delete;
+
+	// Queue a read of the whole file, thread safe.
+	// With readahead, the system is hinted to fetch the file sequentially ahead of the read.
+	void Read(stl::string path, Callback done, bool readahead = true);
+
+	// Block until every queued read and its completion has finished.
+	void Wait();
+
+	// Returns true if reads go through io_uring.
+	inline bool IsUring() const { return ring != 0; }
+
+	// Queued read, internal.
+	struct Request;
+
+private:
+
+	ThreadPool* pool;
+	unsigned depth;
+	stl::list<MAYA_STL thread> threads;
+	MAYA_STL deque<Request*> queue;
+	MAYA_STL mutex mutex;
+	MAYA_STL condition_variable wake, idle;
+	unsigned pending;
+	bool stop;
+	void* ring; // io_uring state, null if unavailable.
+
+	void Complete(Request* request, bool ok);
+	void RunRing();
+	void RunPread();
+};
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "./audio.hpp"
+#include "./resampler.hpp"
+
+namespace maya
+{
+
+// Mixes many sounds into a single stereo output stream.
+// Voices are taken from a fixed pool, so starting and stopping sounds never allocates,
+// and each buffer costs one pass over the playing voices regardless of how many are loaded.
+// Control calls are sent to the audio callback through a lock free queue, and may be made from any thread.
+class AudioMixer
+{
+public:
+
+	using uptr = stl::uptr<AudioMixer>;
+	using sptr = stl::sptr<AudioMixer>;
+
+	// Identifies a started sound, 0 is never a valid voice.
+	using Voice = unsigned;
+
+	// Open and start a stereo output stream on the current backend.
+	// At most maxvoices sounds play at once, up to 65535.
+	// Sources at other sample rates are resampled while playing, importing at the mixer rate saves the cost.
+	AudioMixer(unsigned samplerate = 48000, unsigned maxvoices = 64, unsigned framesperbuffer = 0x200);
+
+	// Close the output stream, voices still playing are cut.
+	~AudioMixer();
+
+	// No copy construct.
+	AudioMixer(AudioMixer const&) = delete;
+	AudioMixer& operator=(AudioMixer const&) = delete;
+
+	// Create and return a uptr.
+	static uptr MakeUnique(unsigned samplerate = 48000, unsigned maxvoices = 64, unsigned framesperbuffer = 0x200);
+
+	// Create and return a sptr.
+	static sptr MakeShared(unsigned samplerate = 48000, unsigned maxvoices = 64, unsigned framesperbuffer = 0x200);
+
+	// Play audio data from the start, the data must outlive the voice.
+	// Pan ranges from -1 (left) to 1 (right), mono sources are panned at constant power.
+	// Returns 0 if every voice is busy.
+	Voice Play(struct AudioData const* src, float gain = 1, float pan = 0, bool loop = false);
+
+	// Play a stream from its position, the stream must outlive the voice and be played by one voice at a time.
+	// Returns 0 if every voice is busy.
+	Voice Play(class AudioStream* src, float gain = 1, float pan = 0);
+
+	// Fade the voice out over one buffer, does nothing if it has ended.
+	void Stop(Voice voice);
+
+	// Move a voice to a frame of its source.
+	void Seek(Voice voice, MAYA_STL uint64_t frame);
+
+	// Stop every voice.
+	void StopAll();
+
+	// Change the gain of a voice, ramped over one buffer.
+	void SetGain(Voice voice, float gain);
+
+	// Change the pan of a voice, ramped over one buffer.
+	void SetPan(Voice voice, float pan);
+
+	// Check if the voice is still playing, true from Play until it ends or is stopped.
+	bool IsPlaying(Voice voice) const;
+
+	// Commands sent after this call apply at the output frame, 0 for as soon as possible.
+	// Commands apply in the order sent, so a later time holds back the commands after it.
+	void SetCommandTime(MAYA_STL uint64_t frame);
+
+	// Number of frames sent to the output so far, the time base of SetCommandTime.
+	MAYA_STL uint64_t GetClock() const;
+
+	// Quality of resampling for voices started after this call, by default is MEDIUM_RESAMPLE.
+	void SetResampleQuality(ResampleQuality quality);
+
+	// Retrieve the resampling quality.
+	ResampleQuality GetResampleQuality() const;
+
+	// Gain applied to the sum of all voices, by default is 1.0f.
+	void SetMasterGain(float gain);
+
+	// Retrieve the master gain.
+	float GetMasterGain() const;
+
+	// Number of voices playing.
+	unsigned GetActiveVoices() const;
+
+	// Size of the voice pool.
+	unsigned GetMaxVoices() const;
+
+	// Output sample rate in Hz.
+	unsigned GetSampleRate() const;
+
+	// Stop the output device, voices keep their positions.
+	void Pause();
+
+	// Restart the output device.
+	void Resume();
+
+	// Check if the output device is running.
+	bool IsRunning() const;
+
+	// Timing of the audio callback, for tuning the frames per buffer.
+	inline AudioStats GetStats() const { return output.GetStats(); }
+
+	// Output stream of the mixer, for offline rendering.
+	inline AudioOutput& GetOutput() { return output; }
+
+private:
+
+	AudioOutput output;
+	stl::uptr<struct MixerState> state;
+};
+
+}
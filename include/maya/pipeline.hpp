@@ -0,0 +1,103 @@
+#pragma once
+
+#include "./fileio.hpp"
+#include "./texture.hpp"
+
+namespace maya
+{
+
+// Loads assets through three overlapping stages: file reads on I/O threads, decoding on worker threads,
+// and uploads on the rendering thread within a time budget per frame.
+// A bounded number of assets is held between stages, so a slow stage holds back the reads
+// instead of letting decoded data pile up.
+class AssetPipeline
+{
+public:
+
+	using uptr = stl::uptr<AssetPipeline>;
+	using sptr = stl::sptr<AssetPipeline>;
+
+	// Decode the file content on a worker thread, ok is false if the file cannot be read.
+	// Returns the upload to run on the rendering thread, or empty if there is nothing to upload.
+	using Decoder = stl::fnptr<stl::fnptr<void()>(stl::list<unsigned char>& data, bool ok)>;
+
+	// Number of assets in each stage and seconds spent in each stage, summed over assets.
+	struct Stats
+	{
+		unsigned Waiting, Reading, Decoding, Uploading, Done;
+		float ReadTime, DecodeTime, UploadTime;
+	};
+
+	// At most capacity assets are held from the start of their read until uploaded.
+	// Decoding runs on threads, 0 for hardware concurrency.
+	AssetPipeline(unsigned capacity = 32, unsigned threads = 0);
+
+	// Finish reads and decodes in flight, pending uploads are dropped.
+	~AssetPipeline();
+
+	// No copy construct.
+	AssetPipeline(AssetPipeline const&) = delete;
+	AssetPipeline& operator=(AssetPipeline const&) = delete;
+
+	// Create and return a uptr.
+	static uptr MakeUnique(unsigned capacity = 32, unsigned threads = 0);
+
+	// Create and return a sptr.
+	static sptr MakeShared(unsigned capacity = 32, unsigned threads = 0);
+
+	// Queue an asset file and return its id, call on the rendering thread.
+	unsigned Load(stl::string path, Decoder decoder);
+
+	// Queue an image file for an initialized texture, with the mipmap chain generated while decoding.
+	// The texture is written by Update, so it must outlive the load or have the load cancelled first.
+	unsigned LoadTexture(stl::string path, Texture& texture, bool mipmaps = true);
+
+	// Drop the upload of an asset not yet done, call on the rendering thread.
+	// A read or decode in flight still finishes, but its upload never runs. The asset then counts as done.
+	void Cancel(unsigned id);
+
+	// Call once per frame on the rendering thread.
+	// Runs finished uploads for at most maxtime seconds, then starts reads as capacity frees up.
+	void Update(float maxtime = 0.002f);
+
+	// Returns true if the asset is uploaded, or failed.
+	bool IsDone(unsigned id) const;
+
+	// Returns true if nothing is queued or in flight.
+	bool IsIdle() const;
+
+	// Get the current stage counts and timings.
+	Stats GetStats() const;
+
+private:
+
+	struct Item {
+		unsigned Id;
+		stl::string Path;
+		Decoder Decode;
+	};
+
+	struct Upload {
+		unsigned Id;
+		stl::fnptr<void()> Run;
+	};
+
+	// Declared in this order so that the reader finishes its completions before the pool stops.
+	ThreadPool decoders;
+	AsyncFileReader reader;
+
+	unsigned capacity, inflight;
+	MAYA_STL deque<Item> waiting;
+	stl::list<bool> done, cancelled;
+
+	mutable MAYA_STL mutex mutex;
+	MAYA_STL deque<Upload> uploads;
+	stl::list<MAYA_STL pair<CoreManager::ErrorCode, stl::string>> errors;
+	stl::atomic<unsigned> reading, decoding;
+	stl::atomic<int64_t> readtime, decodetime;
+	int64_t uploadtime;
+
+	void Issue();
+};
+
+}
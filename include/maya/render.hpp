@@ -58,6 +58,9 @@ public:
 	// Bind a texture to a specific slot, optional.
 	void SetTexture(class Texture* tex, int slot);
 
+	// Bind a texture array to a specific slot, optional.
+	void SetTextureArray(class TextureArray* tex, int slot);
+
 	// Get the current vertex array.
 	inline VertexArray* GetInput() { return input; }
 
@@ -67,6 +70,9 @@ public:
 	// Get the current texture to a slot.
 	inline Texture* GetTexture(int slot) { return textures[slot]; }
 
+	// Get the current texture array to a slot.
+	inline TextureArray* GetTextureArray(int slot) { return texturearrays[slot]; }
+
 	// Settings for rendering.
 	enum Options
 	{
@@ -101,6 +107,9 @@ public:
 	// Draw the current bounded setup.
 	void DrawSetup();
 
+	// Get the number of frames presented by the window, incremented on swap buffers.
+	inline MAYA_STL uint64_t GetFrame() const { return frame; }
+
 	// Get the maximum number of texture slots available.
 	inline MAYA_STL size_t GetMaxTextureSlots() const { return textures.size(); }
 
@@ -125,8 +134,10 @@ private:
 	VertexArray* input;
 	ShaderProgram* program;
 	stl::list<Texture*> textures;
+	stl::list<TextureArray*> texturearrays;
 	unsigned settings;
 	BlendMode blendmode;
+	MAYA_STL uint64_t frame;
 
 	friend class Window;
 	friend class RenderResource;
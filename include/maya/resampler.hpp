@@ -0,0 +1,109 @@
+#pragma once
+
+#include "./core.hpp"
+
+namespace maya
+{
+
+// Length of the filter, which trades cost for a sharper cutoff and less aliasing.
+enum ResampleQuality
+{
+	LOW_RESAMPLE,		// 8 taps, for previews and many voices
+	MEDIUM_RESAMPLE,	// 32 taps, passes up to about 16 kHz at 44.1 kHz
+	HIGH_RESAMPLE		// 64 taps, passes up to about 18 kHz at 44.1 kHz with 90 dB rejection
+};
+
+// Polyphase windowed sinc filter converting between two sample rates.
+// The table is immutable once built, so one filter can be shared by many resamplers.
+class ResampleFilter
+{
+public:
+
+	using sptr = stl::sptr<ResampleFilter const>;
+
+	// Build the table, the cutoff is lowered below the target Nyquist frequency when downsampling.
+	ResampleFilter(unsigned srcrate, unsigned dstrate, ResampleQuality quality = MEDIUM_RESAMPLE);
+
+	// Create and return a sptr.
+	static sptr MakeShared(unsigned srcrate, unsigned dstrate, ResampleQuality quality = MEDIUM_RESAMPLE);
+
+	// Input and output rates in Hz.
+	inline unsigned GetSourceRate() const { return srcrate; }
+	inline unsigned GetTargetRate() const { return dstrate; }
+
+	// Quality the table was built for.
+	inline ResampleQuality GetQuality() const { return quality; }
+
+	// Number of input frames each output frame reads.
+	inline unsigned GetTaps() const { return taps; }
+
+private:
+
+	friend class Resampler;
+
+	unsigned srcrate, dstrate;
+	ResampleQuality quality;
+
+	// The ratio is reduced to up / down. Each of the phases holds taps coefficients, plus one extra phase
+	// so that ratios with more phases than the table interpolate between neighbours.
+	unsigned up, down, taps, phases;
+	stl::list<float> coefficients;
+};
+
+// Converts interleaved frames from one sample rate to another, a block at a time.
+// Input is kept between calls, so a stream can be fed in pieces of any size with no seams.
+// Output frame n sits at input frame n * srcrate / dstrate, the filter looks taps / 2 frames ahead.
+class Resampler
+{
+public:
+
+	using uptr = stl::uptr<Resampler>;
+
+	// Build a filter for the rates.
+	Resampler(unsigned channels, unsigned srcrate, unsigned dstrate, ResampleQuality quality = MEDIUM_RESAMPLE);
+
+	// Share an existing filter.
+	Resampler(unsigned channels, ResampleFilter::sptr filter);
+
+	// No copy construct.
+	Resampler(Resampler const&) = delete;
+	Resampler& operator=(Resampler const&) = delete;
+
+	// Create and return a uptr.
+	static uptr MakeUnique(unsigned channels, unsigned srcrate, unsigned dstrate, ResampleQuality quality = MEDIUM_RESAMPLE);
+	static uptr MakeUnique(unsigned channels, ResampleFilter::sptr filter);
+
+	// Produce up to outframes frames from up to inframes input frames, returns the number produced.
+	// Input is buffered ahead as room allows, and consumed is set to the frames taken. Does not allocate.
+	unsigned Process(float* out, unsigned outframes, float const* in, unsigned inframes, unsigned& consumed);
+
+	// Number of input frames the next outframes output frames need.
+	// Given exactly that many, Process takes all of them, so a stream can be read without leftovers.
+	MAYA_STL size_t GetInputFrames(unsigned outframes) const;
+
+	// Forget all input, the next output frame sits at the next input frame.
+	void Reset();
+
+	// Number of interleaved channels.
+	inline unsigned GetChannels() const { return channels; }
+
+	// The filter in use.
+	inline ResampleFilter::sptr const& GetFilter() const { return filter; }
+
+private:
+
+	ResampleFilter::sptr filter;
+	unsigned channels;
+
+	// Input history of each channel, stride frames apart. Output reads taps frames from base,
+	// at frac / up of the way to the next frame.
+	stl::list<float> history;
+	unsigned stride, filled, base, frac;
+};
+
+// Resample a whole buffer of interleaved frames, including the tail of the filter.
+// The output has frames * dstrate / srcrate frames, rounded up.
+void ResampleSamples(stl::list<float>& dst, float const* src, unsigned channels, MAYA_STL size_t frames,
+	unsigned srcrate, unsigned dstrate, ResampleQuality quality = HIGH_RESAMPLE);
+
+}
@@ -46,8 +46,13 @@ public:
 	};
 
 	// Complie a shader of a type.
+	// Identical sources are compiled once per context and shared between programs.
 	void CompileShader(ShaderType type, char const* source);
 
+	// Read a shader source file and compile it.
+	// Programs created from files can be watched by ShaderHotReloader.
+	void CompileShaderFile(ShaderType type, char const* path);
+
 	// Link the shaders compiled.
 	void LinkProgram();
 
@@ -69,9 +74,70 @@ public:
 private:
 
 	stl::array<MAYA_STL uint32_t, 3> shaderids;
+	stl::array<stl::string, 3> sourcepaths;
 	stl::hashmap<stl::strview, int> uniform_location_cache;
+	class ShaderHotReloader* reloader = 0;
+
+	friend class ShaderHotReloader;
 
 	int FindUniformLocation(stl::strview name);
+	bool Rebuild(stl::array<stl::string, 3> const& sources);
+};
+
+// Watches shader source files in the background and reloads the programs on change.
+// Compilation happens in ApplyChanges(), a failed reload keeps the old program.
+class ShaderHotReloader
+{
+public:
+
+	// Start the watching thread.
+	ShaderHotReloader();
+
+	// Stop the watching thread, programs are unwatched.
+	~ShaderHotReloader();
+
+	// No copy construct.
+	ShaderHotReloader(ShaderHotReloader const&) = delete;
+	ShaderHotReloader& operator=(ShaderHotReloader const&) = delete;
+
+	// Watch the source files of a program created by CompileShaderFile.
+	void Watch(ShaderProgram& program);
+
+	// Stop watching a program, called automatically when the program is freed.
+	void Unwatch(ShaderProgram& program);
+
+	// Swap in the programs whose sources have changed.
+	// Call at frame boundaries on the rendering thread.
+	void ApplyChanges();
+
+	// Returns true if some changes are waiting for ApplyChanges().
+	bool HasPendingChanges() const;
+
+private:
+
+	struct WatchEntry {
+		stl::array<stl::string, 3> Paths;
+		stl::array<MAYA_STL int64_t, 3> Stamps;
+		stl::array<int, 3> Watches;
+	};
+
+	// Directory watched for changes, removed once no program has a source in it.
+	struct WatchDir {
+		stl::string Path;
+		unsigned Refs;
+	};
+
+	MAYA_STL thread thread;
+	stl::atomic<bool> running;
+	mutable MAYA_STL mutex mut;
+	stl::hashmap<ShaderProgram*, WatchEntry> entries;
+	stl::hashmap<ShaderProgram*, stl::array<stl::string, 3>> pending;
+	stl::hashmap<int, WatchDir> watchdirs;
+	int inotifyfd;
+
+	void WatchFiles();
+	void ReleaseWatches(WatchEntry const& entry);
+	void ReadChanged(stl::string const& path);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "./texture.hpp"
+#include "./dataio.hpp"
+#include <condition_variable>
+#include <deque>
+
+namespace maya
+{
+
+// Keeps the textures loaded from files within a video memory budget.
+// Least recently used textures are dropped to their small mipmap levels when over budget,
+// and reloaded in the background when acquired again.
+class TextureStreamer
+{
+public:
+
+	using uptr = stl::uptr<TextureStreamer>;
+	using sptr = stl::sptr<TextureStreamer>;
+
+	// Constructor, budget is in bytes.
+	// Levels not larger than lowres pixels are kept in memory for evicted textures.
+	TextureStreamer(RenderContext& rc, MAYA_STL size_t budget, int lowres = 32);
+
+	// Stop the loading thread.
+	~TextureStreamer();
+
+	// No copy construct.
+	TextureStreamer(TextureStreamer const&) = delete;
+	TextureStreamer& operator=(TextureStreamer const&) = delete;
+
+	// Create and return a uptr.
+	static uptr MakeUnique(RenderContext& rc, MAYA_STL size_t budget, int lowres = 32);
+
+	// Create and return a sptr.
+	static sptr MakeShared(RenderContext& rc, MAYA_STL size_t budget, int lowres = 32);
+
+	// Register an image file and return its id, nothing is loaded until acquired.
+	int Add(char const* path, bool mipmaps = true);
+
+	// Get the texture for drawing, an evicted texture is scheduled for reloading
+	// and its low resolution content is used meanwhile.
+	Texture* Acquire(int id);
+
+	// Returns true if the full resolution content is loaded.
+	bool IsResident(int id) const;
+
+	// Call once per frame on the rendering thread.
+	// Uploads finished loads for at most maxtime seconds, then evicts until within budget.
+	// Files that failed to load are reported here.
+	void Update(float maxtime = 0.002f);
+
+	// Set the budget in bytes.
+	void SetBudget(MAYA_STL size_t budget);
+
+	// Get the budget in bytes.
+	inline MAYA_STL size_t GetBudget() const { return budget; }
+
+	// Get the video memory used by all the textures, in bytes.
+	MAYA_STL size_t GetMemoryUsage() const;
+
+private:
+
+	enum State { EVICTED, LOADING, RESIDENT, FAILED };
+
+	struct Entry {
+		stl::string Path;
+		bool Mipmaps;
+		State Status;
+		Texture::uptr Tex;
+		MipmapData Low;
+	};
+
+	struct Loaded {
+		int Id;
+		MipmapData Mipmaps;
+		CoreManager::ErrorCode Code = CoreManager::FILE_FORMAT_ERROR;
+		stl::string Error; // reported by Update, the error queue is not thread safe.
+	};
+
+	RenderContext* rc;
+	MAYA_STL size_t budget;
+	int lowres;
+	stl::list<Entry> entries;
+
+	MAYA_STL thread thread;
+	MAYA_STL mutex mut;
+	MAYA_STL condition_variable cv;
+	MAYA_STL deque<int> requests;
+	MAYA_STL deque<Loaded> loaded;
+	bool running;
+
+	void LoadRequests();
+	void Evict(Entry& entry);
+};
+
+}
@@ -36,7 +36,18 @@ public:
 
 	// Create an image content of size for the texture.
 	// data can be nullptr if an empty texture is desired.
-	void CreateContent(void const* data, Ivec2 size, int channels);
+	// Bit depth of 8 expects unsigned bytes, 16 half floats and 32 floats,
+	// the internal format is chosen accordingly (e.g. R8, RGB8, RGBA16F).
+	void CreateContent(void const* data, Ivec2 size, int channels, int bitdepth = 8);
+
+	// Update a sub rectangle of level 0, data has the channels and bit depth of the texture.
+	void UpdateContent(void const* data, Ivec2 offset, Ivec2 size);
+
+	// Create the content with every level of a mipmap chain.
+	void CreateContent(struct MipmapData const& mipmaps);
+
+	// Create the content from block compressed data, BC1 and BC3 require S3TC support.
+	void CreateContent(struct CompressedImageData const& image);
 
 	void SetRepeat();
 
@@ -44,17 +55,174 @@ public:
 
 	void SetFilterLinear();
 
+	// Linear filtering between mipmap levels, falls back to linear without mipmaps.
+	// Anisotropy is clamped to the maximum supported by the device.
+	void SetFilterTrilinear(float anisotropy = 1.0f);
+
 	// Get the size of the texture.
 	inline Ivec2 GetSize() const { return size; }
 
 	// Get the number of channels of the texture.
 	inline int GetChannels() const { return channels; }
 
+	// Get the bits per channel of the texture.
+	inline int GetBitDepth() const { return bitdepth; }
+
+	// Get the number of mipmap levels.
+	inline int GetLevels() const { return levels; }
+
+	// Get the approximate video memory used by every level, in bytes.
+	inline MAYA_STL size_t GetMemorySize() const { return memsize; }
+
+	// Get the frame when the texture was last bound by RenderContext::SetTexture.
+	inline MAYA_STL uint64_t GetLastUseFrame() const { return lastuse; }
+
+	// Returns true if the storage is allocated with glTexStorage2D.
+	inline bool IsImmutable() const { return immutable; }
+
+private:
+
+	Ivec2 size;
+	int channels;
+	int bitdepth;
+	int levels;
+	bool immutable;
+	MAYA_STL size_t memsize;
+	MAYA_STL uint64_t lastuse;
+
+	friend class RenderContext;
+
+	void ReleaseImmutable();
+	bool AllocateStorage(Ivec2 size, int channels, int bitdepth, int levels);
+
+};
+
+// Array of same sized 2D textures bound as one, the layer is selected in the shader.
+// Lets sprites with different images share a batch without bindless textures.
+class TextureArray : public RenderResource
+{
+public:
+
+	using uptr = stl::uptr<TextureArray>;
+	using sptr = stl::sptr<TextureArray>;
+
+	// Uninitialized.
+	TextureArray(void) = default;
+
+	// Constructor.
+	TextureArray(RenderContext& rc);
+
+	// Cleanup resources.
+	~TextureArray();
+
+	// Create and return a uptr.
+	static uptr MakeUnique(RenderContext& rc);
+
+	// Create and return a sptr.
+	static sptr MakeShared(RenderContext& rc);
+
+	// Initialize texture array.
+	virtual void Init(RenderContext& rc) override;
+
+	// Free texture array.
+	virtual void Free() override;
+
+	// Allocate empty 8-bit layers of a size.
+	void CreateContent(Ivec2 size, int layers, int channels, int levels = 1);
+
+	// Upload a layer of a mipmap level, data has the size and channels of the array.
+	void SetLayer(int layer, void const* data, int level = 0);
+
+	// Upload an image to a layer, it must match the size and channels of the array.
+	void SetLayer(int layer, struct ImageData const& image);
+
+	// Upload the levels of a mipmap chain to a layer.
+	void SetLayer(int layer, struct MipmapData const& mipmaps);
+
+	// Generate the mipmap levels of every layer from level 0.
+	void GenerateMipmaps();
+
+	void SetRepeat();
+
+	void SetClampToEdge();
+
+	void SetFilterLinear();
+
+	// Linear filtering between mipmap levels, falls back to linear without mipmaps.
+	void SetFilterTrilinear(float anisotropy = 1.0f);
+
+	// Get the size of each layer.
+	inline Ivec2 GetSize() const { return size; }
+
+	// Get the number of layers.
+	inline int GetLayers() const { return layers; }
+
+	// Get the number of channels.
+	inline int GetChannels() const { return channels; }
+
+	// Get the number of mipmap levels.
+	inline int GetLevels() const { return levels; }
+
 private:
 
 	Ivec2 size;
+	int layers;
 	int channels;
+	int levels;
+	bool immutable;
+};
+
+// Streams texture updates through a ring of pixel buffer objects.
+// The pixels are copied into a buffer and the transfer happens without blocking the caller,
+// unless every buffer of the ring is still being consumed by the GPU.
+class TextureUploader : public RenderResource
+{
+public:
+
+	using uptr = stl::uptr<TextureUploader>;
+	using sptr = stl::sptr<TextureUploader>;
+
+	// Uninitialized.
+	TextureUploader(void) = default;
+
+	// Constructor, buffersize is the size in bytes of each of the count buffers.
+	TextureUploader(RenderContext& rc, MAYA_STL size_t buffersize = 1 << 22, int count = 3);
+
+	// Cleanup resources.
+	~TextureUploader();
+
+	// Create and return a uptr.
+	static uptr MakeUnique(RenderContext& rc, MAYA_STL size_t buffersize = 1 << 22, int count = 3);
+
+	// Create and return a sptr.
+	static sptr MakeShared(RenderContext& rc, MAYA_STL size_t buffersize = 1 << 22, int count = 3);
+
+	// Initialize buffers with the default sizes.
+	virtual void Init(RenderContext& rc) override;
+
+	// Initialize buffers, at least one.
+	void Init(RenderContext& rc, MAYA_STL size_t buffersize, int count);
+
+	// Free buffers.
+	virtual void Free() override;
+
+	// Upload a sub rectangle of level 0, data has the channels and bit depth of the texture.
+	// Images larger than a buffer are split into bands of rows.
+	void Upload(Texture& tex, void const* data, Ivec2 offset, Ivec2 size);
+
+	// Get the number of times an upload had to wait for a buffer.
+	inline unsigned GetStallCount() const { return stalls; }
+
+private:
+
+	struct Slot {
+		MAYA_STL uint32_t Buffer;
+		void* Fence;
+	};
 
+	stl::list<Slot> slots;
+	MAYA_STL size_t buffersize;
+	unsigned current, stalls;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,561 @@
+#include <maya/archive.hpp>
+#include <maya/async.hpp>
+#include <maya/audioconvert.hpp>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+namespace maya
+{
+
+// Layout of the file, all integers are little endian:
+// header, blobs each aligned to s_ArchiveAlign, then the table of contents at the end.
+// A compressed blob starts with the chunk count, raw chunk size and the stored size of each chunk,
+// followed by the chunks. A chunk that does not compress is stored raw, marked by s_RawChunk.
+static char const s_ArchiveMagic[8] = { 'M', 'A', 'Y', 'A', 'P', 'A', 'K', 0 };
+static constexpr uint32_t s_ArchiveVersion = 1;
+static constexpr MAYA_STL size_t s_ArchiveAlign = 64;
+static constexpr uint32_t s_ArchiveChunk = 1 << 18;
+static constexpr uint32_t s_RawChunk = 0x80000000u;
+static constexpr uint32_t s_CompressedFlag = 1;
+
+struct s_ArchiveHeader
+{
+	char magic[8];
+	uint32_t version, count;
+	uint64_t tocoffset, tocsize;
+	uint8_t reserved[32];
+};
+
+struct s_ArchiveRecord
+{
+	uint32_t type, flags;
+	uint64_t offset, storedsize, size;
+	int32_t layout[4];
+	uint32_t namelen, reserved;
+};
+
+static_assert(sizeof(s_ArchiveHeader) == 64 && sizeof(s_ArchiveRecord) == 56);
+
+static inline uint32_t s_Read32(unsigned char const* p)
+{
+	uint32_t v;
+	MAYA_STL memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint32_t s_Lz4Hash(uint32_t seq)
+{
+	return (seq * 2654435761u) >> 16;
+}
+
+static void s_Lz4Length(stl::list<unsigned char>& out, MAYA_STL size_t len)
+{
+	for (; len >= 255; len -= 255) out.push_back(255);
+	out.push_back(static_cast<unsigned char>(len));
+}
+
+// Compress into the LZ4 block format with greedy hash matching.
+static void s_Lz4Compress(unsigned char const* src, MAYA_STL size_t size, stl::list<unsigned char>& out)
+{
+	// The format requires the last match to start 12 bytes and end 5 bytes before the end.
+	constexpr MAYA_STL size_t mflimit = 12, lastliterals = 5;
+	out.clear();
+	out.reserve(size + size / 255 + 16);
+	stl::list<int32_t> table(1 << 16, -1);
+	MAYA_STL size_t anchor = 0, i = 0;
+
+	while (size > mflimit && i < size - mflimit)
+	{
+		uint32_t seq = s_Read32(src + i);
+		int32_t& slot = table[s_Lz4Hash(seq)];
+		MAYA_STL size_t ref = static_cast<MAYA_STL size_t>(slot);
+		slot = static_cast<int32_t>(i);
+		if (ref == static_cast<MAYA_STL size_t>(-1) || i - ref > 65535 || s_Read32(src + ref) != seq) {
+			i++;
+			continue;
+		}
+
+		MAYA_STL size_t len = 4, maxlen = size - lastliterals - i;
+		while (len < maxlen && src[ref + len] == src[i + len]) len++;
+
+		MAYA_STL size_t literals = i - anchor, extra = len - 4;
+		out.push_back(static_cast<unsigned char>((MAYA_STL min<MAYA_STL size_t>(literals, 15) << 4) | MAYA_STL min<MAYA_STL size_t>(extra, 15)));
+		if (literals >= 15) s_Lz4Length(out, literals - 15);
+		out.insert(out.end(), src + anchor, src + i);
+		MAYA_STL size_t offset = i - ref;
+		out.push_back(static_cast<unsigned char>(offset));
+		out.push_back(static_cast<unsigned char>(offset >> 8));
+		if (extra >= 15) s_Lz4Length(out, extra - 15);
+		i += len;
+		anchor = i;
+	}
+
+	MAYA_STL size_t literals = size - anchor;
+	out.push_back(static_cast<unsigned char>(MAYA_STL min<MAYA_STL size_t>(literals, 15) << 4));
+	if (literals >= 15) s_Lz4Length(out, literals - 15);
+	out.insert(out.end(), src + anchor, src + size);
+}
+
+// Decompress an LZ4 block into exactly size bytes, returns false if malformed.
+static bool s_Lz4Decompress(unsigned char const* src, MAYA_STL size_t srcsize, unsigned char* dst, MAYA_STL size_t size)
+{
+	MAYA_STL size_t ip = 0, op = 0;
+	auto length = [&](MAYA_STL size_t& len) {
+		unsigned char b;
+		do {
+			if (ip >= srcsize) return false;
+			b = src[ip++];
+			len += b;
+		} while (b == 255);
+		return true;
+	};
+
+	while (ip < srcsize)
+	{
+		unsigned token = src[ip++];
+		MAYA_STL size_t literals = token >> 4;
+		if (literals == 15 && !length(literals)) return false;
+		if (literals > srcsize - ip || literals > size - op) return false;
+		MAYA_STL memcpy(dst + op, src + ip, literals);
+		ip += literals;
+		op += literals;
+		if (ip == srcsize) break;
+
+		if (srcsize - ip < 2) return false;
+		MAYA_STL size_t offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		MAYA_STL size_t len = token & 15;
+		if (len == 15 && !length(len)) return false;
+		len += 4;
+		if (!offset || offset > op || len > size - op) return false;
+		unsigned char* from = dst + op - offset;
+		if (offset >= len) MAYA_STL memcpy(dst + op, from, len);
+		else for (MAYA_STL size_t k = 0; k < len; k++) dst[op + k] = from[k];
+		op += len;
+	}
+	return op == size;
+}
+
+bool AssetArchive::Open(char const* path)
+{
+	Close();
+	auto error = [&](char const* reason) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_FORMAT_ERROR, "Invalid archive \"" + stl::string(path) + "\": " + reason);
+		return false;
+	};
+
+	auto mapped = MAYA_STL make_shared<MappedFile>();
+	if (!mapped->Open(path)) return false;
+	unsigned char const* data = mapped->GetData();
+	MAYA_STL size_t size = mapped->GetSize();
+
+	s_ArchiveHeader header;
+	if (size < sizeof(header)) return error("file is too small");
+	MAYA_STL memcpy(&header, data, sizeof(header));
+	if (MAYA_STL memcmp(header.magic, s_ArchiveMagic, sizeof(s_ArchiveMagic)) != 0) return error("bad magic");
+	if (header.version != s_ArchiveVersion) return error("unsupported version");
+	if (header.tocoffset > size || header.tocsize > size - header.tocoffset) return error("table of contents out of range");
+	if (header.count > header.tocsize / sizeof(s_ArchiveRecord)) return error("bad asset count");
+
+	entries.resize(header.count);
+	MAYA_STL size_t pos = header.tocoffset, end = header.tocoffset + header.tocsize;
+	for (auto& entry : entries)
+	{
+		s_ArchiveRecord record;
+		if (end - pos < sizeof(record)) return Close(), error("truncated table of contents");
+		MAYA_STL memcpy(&record, data + pos, sizeof(record));
+		pos += sizeof(record);
+		if (end - pos < record.namelen) return Close(), error("truncated table of contents");
+		if (record.offset > size || record.storedsize > size - record.offset) return Close(), error("blob out of range");
+		if (!(record.flags & s_CompressedFlag) && record.size != record.storedsize) return Close(), error("bad blob size");
+		if (record.flags & s_CompressedFlag) {
+			// Imports allocate the size before reading, so it must be covered by the chunks actually stored.
+			if (record.storedsize < 8) return Close(), error("bad blob size");
+			uint32_t count = s_Read32(data + record.offset), chunk = s_Read32(data + record.offset + 4);
+			if (!chunk || chunk > s_ArchiveChunk || count > (record.storedsize - 8) / 4
+				|| record.size > static_cast<uint64_t>(count) * chunk) return Close(), error("bad blob size");
+		}
+		entry.Name.assign(reinterpret_cast<char const*>(data + pos), record.namelen);
+		pos += record.namelen;
+		entry.Type = static_cast<AssetType>(record.type);
+		entry.Compressed = record.flags & s_CompressedFlag;
+		entry.Offset = record.offset;
+		entry.StoredSize = record.storedsize;
+		entry.Size = record.size;
+		MAYA_STL copy_n(record.layout, 4, entry.Layout);
+	}
+
+	// Names are viewed in place, entries are not resized until closed.
+	lookup.reserve(entries.size());
+	for (int i = 0; i < static_cast<int>(entries.size()); i++)
+		lookup.emplace(entries[i].Name, i);
+	file = MAYA_STL move(mapped);
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	lookup.clear();
+	entries.clear();
+	file.reset();
+}
+
+int AssetArchive::Find(stl::strview name) const
+{
+	auto it = lookup.find(name);
+	return it == lookup.end() ? -1 : it->second;
+}
+
+ConstBuffer<void> AssetArchive::GetView(int index) const
+{
+	auto& entry = entries[index];
+	if (entry.Compressed) return {};
+	return { file->GetData() + entry.Offset, entry.Size };
+}
+
+bool AssetArchive::Read(int index, void* dst) const
+{
+	auto& entry = entries[index];
+	unsigned char const* src = file->GetData() + entry.Offset;
+	auto* out = static_cast<unsigned char*>(dst);
+	if (!entry.Compressed) {
+		MAYA_STL memcpy(out, src, entry.Size);
+		return true;
+	}
+
+	auto error = [&]() {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_FORMAT_ERROR, "Corrupted asset \"" + entry.Name + "\" in archive");
+		return false;
+	};
+
+	if (entry.StoredSize < 8) return error();
+	uint32_t count = s_Read32(src), chunk = s_Read32(src + 4);
+	if (!chunk || count != (entry.Size + chunk - 1) / chunk || (entry.StoredSize - 8) / 4 < count) return error();
+
+	stl::list<MAYA_STL size_t> offsets(count + 1);
+	offsets[0] = 8 + static_cast<MAYA_STL size_t>(count) * 4;
+	for (uint32_t i = 0; i < count; i++)
+		offsets[i + 1] = offsets[i] + (s_Read32(src + 8 + i * 4) & ~s_RawChunk);
+	if (offsets[count] > entry.StoredSize) return error();
+
+	stl::atomic<bool> ok = true;
+	ParallelFor(static_cast<int>(count), 0, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			MAYA_STL size_t start = static_cast<MAYA_STL size_t>(i) * chunk;
+			MAYA_STL size_t size = MAYA_STL min<MAYA_STL size_t>(chunk, entry.Size - start);
+			MAYA_STL size_t stored = offsets[i + 1] - offsets[i];
+			if (s_Read32(src + 8 + i * 4) & s_RawChunk) {
+				if (stored != size) ok = false;
+				else MAYA_STL memcpy(out + start, src + offsets[i], size);
+			}
+			else if (!s_Lz4Decompress(src + offsets[i], stored, out + start, size)) ok = false;
+		}
+	}, 1);
+	return ok ? true : error();
+}
+
+void AssetArchive::Prefetch(int index) const
+{
+	auto& entry = entries[index];
+	file->Prefetch(entry.Offset, entry.StoredSize);
+}
+
+void AssetArchiveWriter::Push(char const* name, AssetType type, bool compress, int const* layout, void const* data, MAYA_STL size_t size)
+{
+	auto& blob = blobs.emplace_back();
+	blob.Name = name;
+	blob.Type = type;
+	blob.Compress = compress;
+	MAYA_STL copy_n(layout, 4, blob.Layout);
+	auto* bytes = static_cast<unsigned char const*>(data);
+	blob.Data.assign(bytes, bytes + size);
+}
+
+void AssetArchiveWriter::Add(char const* name, ImageData const& image, bool compress)
+{
+	int layout[4] = { image.Size.x, image.Size.y, image.Channels, 0 };
+	Push(name, IMAGE_ASSET, compress, layout, image.Data.data(), image.Data.size());
+}
+
+void AssetArchiveWriter::Add(char const* name, CompressedImageData const& image, bool compress)
+{
+	int layout[4] = { image.Size.x, image.Size.y, image.Format, static_cast<int>(image.Levels.size()) };
+	Push(name, COMPRESSED_IMAGE_ASSET, compress, layout, 0, 0);
+	auto& data = blobs.back().Data;
+	for (auto& level : image.Levels) {
+		uint64_t size = level.size();
+		auto* bytes = reinterpret_cast<unsigned char const*>(&size);
+		data.insert(data.end(), bytes, bytes + sizeof(size));
+	}
+	for (auto& level : image.Levels)
+		data.insert(data.end(), level.begin(), level.end());
+}
+
+void AssetArchiveWriter::Add(char const* name, AudioData const& audio, bool compress)
+{
+	int layout[4] = { static_cast<int>(audio.SampleRate), static_cast<int>(audio.Channels),
+		static_cast<int>(audio.Storage), static_cast<int>(audio.EncodedFrames) };
+	if (audio.Storage == FLOAT_STORAGE)
+		Push(name, AUDIO_ASSET, compress, layout, audio.Samples.data(), audio.Samples.size() * sizeof(float));
+	else
+		Push(name, AUDIO_ASSET, compress, layout, audio.Encoded.data(), audio.Encoded.size());
+}
+
+void AssetArchiveWriter::AddFont(char const* name, char const* path, bool compress)
+{
+	std::ifstream ifs(path, std::ios::binary);
+	if (!ifs.is_open()) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR, "Unable to open file: " + stl::string(path));
+		return;
+	}
+	int layout[4] = { 0 };
+	Push(name, FONT_ASSET, compress, layout, 0, 0);
+	auto& data = blobs.back().Data;
+	data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+void AssetArchiveWriter::AddRaw(char const* name, ConstBuffer<void> data, bool compress)
+{
+	int layout[4] = { 0 };
+	Push(name, RAW_ASSET, compress, layout, data.Data, data.Size);
+}
+
+bool AssetArchiveWriter::Write(char const* path, unsigned threads) const
+{
+	std::ofstream ofs(path, std::ios::binary);
+	if (!ofs.is_open()) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR, "Unable to open file: " + stl::string(path));
+		return false;
+	}
+
+	s_ArchiveHeader header = {};
+	ofs.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	MAYA_STL size_t pos = sizeof(header);
+	stl::list<s_ArchiveRecord> records(blobs.size());
+	stl::list<stl::list<unsigned char>> chunks;
+	char const zeros[s_ArchiveAlign] = { 0 };
+
+	for (MAYA_STL size_t b = 0; b < blobs.size(); b++)
+	{
+		auto& blob = blobs[b];
+		auto& record = records[b];
+		record = {};
+		record.type = blob.Type;
+		record.size = blob.Data.size();
+		record.namelen = static_cast<uint32_t>(blob.Name.size());
+		MAYA_STL copy_n(blob.Layout, 4, record.layout);
+
+		MAYA_STL size_t pad = (s_ArchiveAlign - pos % s_ArchiveAlign) % s_ArchiveAlign;
+		ofs.write(zeros, pad);
+		pos += pad;
+		record.offset = pos;
+
+		if (!blob.Compress || blob.Data.empty()) {
+			ofs.write(reinterpret_cast<char const*>(blob.Data.data()), blob.Data.size());
+			record.storedsize = blob.Data.size();
+			pos += blob.Data.size();
+			continue;
+		}
+
+		uint32_t count = static_cast<uint32_t>((blob.Data.size() + s_ArchiveChunk - 1) / s_ArchiveChunk);
+		chunks.resize(count);
+		stl::list<uint32_t> table(count + 2);
+		table[0] = count;
+		table[1] = s_ArchiveChunk;
+		ParallelFor(static_cast<int>(count), threads, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+			{
+				MAYA_STL size_t start = static_cast<MAYA_STL size_t>(i) * s_ArchiveChunk;
+				MAYA_STL size_t size = MAYA_STL min<MAYA_STL size_t>(s_ArchiveChunk, blob.Data.size() - start);
+				s_Lz4Compress(blob.Data.data() + start, size, chunks[i]);
+				if (chunks[i].size() >= size) {
+					chunks[i].assign(blob.Data.begin() + start, blob.Data.begin() + start + size);
+					table[i + 2] = static_cast<uint32_t>(size) | s_RawChunk;
+				}
+				else table[i + 2] = static_cast<uint32_t>(chunks[i].size());
+			}
+		}, 1);
+
+		ofs.write(reinterpret_cast<char const*>(table.data()), table.size() * sizeof(uint32_t));
+		record.storedsize = table.size() * sizeof(uint32_t);
+		for (auto& chunk : chunks) {
+			ofs.write(reinterpret_cast<char const*>(chunk.data()), chunk.size());
+			record.storedsize += chunk.size();
+		}
+		record.flags = s_CompressedFlag;
+		pos += record.storedsize;
+	}
+
+	header.tocoffset = pos;
+	for (MAYA_STL size_t b = 0; b < blobs.size(); b++) {
+		ofs.write(reinterpret_cast<char const*>(&records[b]), sizeof(s_ArchiveRecord));
+		ofs.write(blobs[b].Name.data(), blobs[b].Name.size());
+		pos += sizeof(s_ArchiveRecord) + blobs[b].Name.size();
+	}
+
+	MAYA_STL memcpy(header.magic, s_ArchiveMagic, sizeof(s_ArchiveMagic));
+	header.version = s_ArchiveVersion;
+	header.count = static_cast<uint32_t>(blobs.size());
+	header.tocsize = pos - header.tocoffset;
+	ofs.seekp(0);
+	ofs.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	return ofs.good();
+}
+
+// Find an asset of the type, reporting an error if absent.
+static int s_FindAsset(AssetArchive const& archive, char const* name, AssetType type)
+{
+	int index = archive.IsOpen() ? archive.Find(name) : -1;
+	auto& cm = *CoreManager::Instance();
+	if (index < 0) {
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR, "Asset \"" + stl::string(name) + "\" is not in the archive");
+		return -1;
+	}
+	if (archive.GetEntry(index).Type != type) {
+		cm.MakeError(cm.FILE_FORMAT_ERROR, "Asset \"" + stl::string(name) + "\" is of another type");
+		return -1;
+	}
+	return index;
+}
+
+// Report an asset whose layout does not match its data.
+static void s_CorruptedAsset(AssetArchive::Entry const& entry)
+{
+	auto& cm = *CoreManager::Instance();
+	cm.MakeError(cm.FILE_FORMAT_ERROR, "Corrupted asset \"" + entry.Name + "\" in archive");
+}
+
+void ImageData::Import(AssetArchive const& archive, char const* name)
+{
+	Data.clear();
+	int index = s_FindAsset(archive, name, IMAGE_ASSET);
+	if (index < 0) return;
+	auto& entry = archive.GetEntry(index);
+
+	// Uploads trust the size and channels, so they must account for the data exactly.
+	int const* layout = entry.Layout;
+	if (layout[0] <= 0 || layout[1] <= 0 || layout[2] <= 0 || layout[2] > 4
+		|| entry.Size != static_cast<uint64_t>(layout[0]) * layout[1] * layout[2]) {
+		s_CorruptedAsset(entry);
+		return;
+	}
+	Size = Ivec2(layout[0], layout[1]);
+	Channels = layout[2];
+
+	if (!entry.Compressed) {
+		// Keep the mapping alive for as long as the pixels are referenced.
+		auto file = archive.GetFile();
+		Data.Adopt(file->GetData() + entry.Offset, entry.Size, [file](unsigned char*) {});
+		return;
+	}
+	Data.resize(entry.Size);
+	if (!archive.Read(index, Data.data())) Data.clear();
+}
+
+void CompressedImageData::Import(AssetArchive const& archive, char const* name)
+{
+	Levels.clear();
+	int index = s_FindAsset(archive, name, COMPRESSED_IMAGE_ASSET);
+	if (index < 0) return;
+	auto& entry = archive.GetEntry(index);
+
+	// Every level must have the size of its blocks, and the chain stops at 1x1.
+	int const* layout = entry.Layout;
+	Ivec2 size(layout[0], layout[1]);
+	CompressedFormat format = static_cast<CompressedFormat>(layout[2]);
+	bool valid = layout[3] >= 0 && (!layout[3] || (size.x > 0 && size.y > 0 && layout[2] >= BC1_FORMAT && layout[2] <= BC5_FORMAT));
+	uint64_t expected = static_cast<uint64_t>(valid ? layout[3] : 0) * sizeof(uint64_t);
+	for (int i = 0; valid && i < layout[3]; i++) {
+		valid = i == 0 || (size.x >> i) > 0 || (size.y >> i) > 0;
+		expected += GetCompressedLevelSize(format, size, i);
+	}
+	if (!valid || entry.Size != expected) {
+		s_CorruptedAsset(entry);
+		return;
+	}
+	Size = size;
+	Format = format;
+
+	stl::list<unsigned char> scratch;
+	unsigned char const* data = static_cast<unsigned char const*>(archive.GetView(index).Data);
+	if (entry.Compressed) {
+		scratch.resize(entry.Size);
+		if (!archive.Read(index, scratch.data())) return;
+		data = scratch.data();
+	}
+
+	MAYA_STL size_t count = layout[3], pos = count * sizeof(uint64_t);
+	Levels.resize(count);
+	for (MAYA_STL size_t i = 0; i < count; i++)
+	{
+		uint64_t levelsize;
+		MAYA_STL memcpy(&levelsize, data + i * sizeof(uint64_t), sizeof(levelsize));
+		if (levelsize != GetCompressedLevelSize(format, size, static_cast<unsigned>(i))) {
+			Levels.clear();
+			s_CorruptedAsset(entry);
+			return;
+		}
+		Levels[i].assign(data + pos, data + pos + levelsize);
+		pos += levelsize;
+	}
+}
+
+void FontData::Import(AssetArchive const& archive, char const* name, int pixelsize, RenderContext& rc)
+{
+	int index = s_FindAsset(archive, name, FONT_ASSET);
+	if (index < 0) return;
+	auto& entry = archive.GetEntry(index);
+	if (!entry.Compressed)
+		return Import(archive.GetView(index), pixelsize, rc);
+	stl::list<unsigned char> scratch(entry.Size);
+	if (archive.Read(index, scratch.data()))
+		Import(ConstBuffer<void>{ scratch.data(), scratch.size() }, pixelsize, rc);
+}
+
+void AudioData::Import(AssetArchive const& archive, char const* name)
+{
+	Samples.clear();
+	Encoded.clear();
+	EncodedFrames = 0;
+	Storage = FLOAT_STORAGE;
+	int index = s_FindAsset(archive, name, AUDIO_ASSET);
+	if (index < 0) return;
+	auto& entry = archive.GetEntry(index);
+	SampleRate = static_cast<unsigned>(entry.Layout[0]);
+	Channels = static_cast<unsigned>(entry.Layout[1]);
+	if (entry.Layout[2] != FLOAT_STORAGE) {
+		// Decoding trusts the frame count, so it must account for the data exactly.
+		MAYA_STL size_t frames = static_cast<MAYA_STL size_t>(static_cast<unsigned>(entry.Layout[3]));
+		bool valid = Channels > 0;
+		if (entry.Layout[2] == INT16_STORAGE)
+			valid = valid && entry.Size == static_cast<uint64_t>(frames) * Channels * sizeof(int16_t);
+		else if (entry.Layout[2] == ADPCM_STORAGE)
+			valid = valid && entry.Size == GetAdpcmSize(Channels, frames);
+		else
+			valid = false;
+		if (!valid) {
+			s_CorruptedAsset(entry);
+			return;
+		}
+		Encoded.resize(entry.Size);
+		if (!archive.Read(index, Encoded.data())) { Encoded.clear(); return; }
+		Storage = static_cast<AudioStorage>(entry.Layout[2]);
+		EncodedFrames = frames;
+		return;
+	}
+	if (!Channels || entry.Size % (sizeof(float) * Channels)) {
+		s_CorruptedAsset(entry);
+		return;
+	}
+	Samples.resize(entry.Size / sizeof(float));
+	if (!archive.Read(index, Samples.data())) Samples.clear();
+}
+
+}
@@ -0,0 +1,176 @@
+#include <maya/archive.hpp>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+
+#if MAYA_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace maya
+{
+
+// Bump when a processed layout changes, so that stale entries are never matched.
+static constexpr uint64_t s_CacheVersion = 1;
+
+static MAYA_STL mutex s_CacheMutex;
+static stl::string s_CacheDirectory;
+
+// Recorded content hash of a source, valid while its size and modification time are unchanged.
+struct s_CacheIndex
+{
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+};
+
+static inline uint64_t s_Mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	return h ^ (h >> 33);
+}
+
+// Hash of bytes, words of 8 bytes are mixed at a time.
+static uint64_t s_Hash(void const* data, MAYA_STL size_t size, uint64_t seed)
+{
+	auto* bytes = static_cast<unsigned char const*>(data);
+	uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+	MAYA_STL size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		MAYA_STL memcpy(&word, bytes + i, 8);
+		h = (h ^ s_Mix(word)) * 0x9e3779b97f4a7c15ull;
+	}
+	uint64_t tail = 0;
+	MAYA_STL memcpy(&tail, bytes + i, size - i);
+	return s_Mix(h ^ s_Mix(tail));
+}
+
+static stl::string s_CacheFile(stl::string const& dir, uint64_t key, char const* ext)
+{
+	char name[32];
+	MAYA_STL snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(key), ext);
+	return (std::filesystem::path(dir) / name).string();
+}
+
+// Write through a temporary file and rename, so that readers never see a partial file.
+static void s_Publish(stl::string const& tmp, stl::string const& path)
+{
+	std::error_code ec;
+	std::filesystem::rename(tmp, path, ec);
+	if (ec) std::filesystem::remove(tmp, ec);
+}
+
+// Unique among the processes sharing the directory, by process id and a count within the process.
+static stl::string s_TempName(stl::string const& path)
+{
+	static stl::atomic<uint64_t> counter = 0;
+#if MAYA_PLATFORM_WINDOWS
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+	char suffix[48];
+	MAYA_STL snprintf(suffix, sizeof(suffix), ".%lu.%llu.tmp", pid,
+		static_cast<unsigned long long>(counter.fetch_add(1, MAYA_STL memory_order_relaxed)));
+	return path + suffix;
+}
+
+// Returns the key of the processed source, or false if the cache is disabled or the source is unreadable.
+static bool s_CacheKey(char const* path, uint64_t params, stl::string& dir, uint64_t& key)
+{
+	{
+		MAYA_STL lock_guard lock(s_CacheMutex);
+		dir = s_CacheDirectory;
+	}
+	if (dir.empty()) return false;
+
+	std::error_code ec;
+	auto source = std::filesystem::absolute(path, ec);
+	if (ec) return false;
+	s_CacheIndex current;
+	current.size = std::filesystem::file_size(source, ec);
+	if (ec) return false;
+	current.mtime = static_cast<int64_t>(std::filesystem::last_write_time(source, ec).time_since_epoch().count());
+	if (ec) return false;
+
+	auto sourcename = source.string();
+	auto indexpath = s_CacheFile(dir, s_Hash(sourcename.data(), sourcename.size(), s_CacheVersion), ".idx");
+	s_CacheIndex index = {};
+	std::ifstream(indexpath, std::ios::binary).read(reinterpret_cast<char*>(&index), sizeof(index));
+
+	if (index.size != current.size || index.mtime != current.mtime)
+	{
+		std::ifstream ifs(source, std::ios::binary);
+		if (!ifs.is_open()) return false;
+		stl::list<char> content(current.size);
+		ifs.read(content.data(), content.size());
+		if (static_cast<uint64_t>(ifs.gcount()) != current.size) return false;
+		current.hash = s_Hash(content.data(), content.size(), s_CacheVersion);
+
+		auto tmp = s_TempName(indexpath);
+		std::ofstream(tmp, std::ios::binary).write(reinterpret_cast<char const*>(&current), sizeof(current));
+		s_Publish(tmp, indexpath);
+		index = current;
+	}
+
+	key = s_Mix(index.hash ^ s_Mix(params + s_CacheVersion));
+	return true;
+}
+
+void AssetCache::SetDirectory(char const* path)
+{
+	stl::string dir = path ? path : "";
+	if (!dir.empty()) {
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (ec) {
+			auto& cm = *CoreManager::Instance();
+			cm.MakeError(cm.FILE_NOT_FOUND_ERROR, "Unable to create cache directory \"" + dir + "\": " + ec.message());
+			dir.clear();
+		}
+	}
+	MAYA_STL lock_guard lock(s_CacheMutex);
+	s_CacheDirectory = MAYA_STL move(dir);
+}
+
+stl::string AssetCache::GetDirectory()
+{
+	MAYA_STL lock_guard lock(s_CacheMutex);
+	return s_CacheDirectory;
+}
+
+bool AssetCache::Load(char const* path, uint64_t params, AssetArchive& archive)
+{
+	stl::string dir;
+	uint64_t key;
+	if (!s_CacheKey(path, params, dir, key)) return false;
+	auto file = s_CacheFile(dir, key, ".pak");
+	std::error_code ec;
+	return std::filesystem::exists(file, ec) && archive.Open(file.c_str());
+}
+
+void AssetCache::Store(char const* path, uint64_t params, AssetArchiveWriter const& writer)
+{
+	stl::string dir;
+	uint64_t key;
+	if (!s_CacheKey(path, params, dir, key)) return;
+	auto file = s_CacheFile(dir, key, ".pak");
+	auto tmp = s_TempName(file);
+	if (writer.Write(tmp.c_str())) s_Publish(tmp, file);
+	else {
+		std::error_code ec;
+		std::filesystem::remove(tmp, ec);
+	}
+}
+
+}
@@ -1,5 +1,6 @@
 #include <maya/async.hpp>
 #include <iostream>
+#include <algorithm>
 
 namespace maya
 {
@@ -74,4 +75,88 @@ unsigned AsyncWorker::GetWorkProgress() const
 	return onwork;
 }
 
+ThreadPool::ThreadPool(unsigned count)
+	: pending(0), stop(false)
+{
+	if (!count)
+		count = MAYA_STL max(1u, MAYA_STL thread::hardware_concurrency());
+	threads.reserve(count);
+	for (unsigned i = 0; i < count; i++)
+		threads.emplace_back(&ThreadPool::Run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		MAYA_STL lock_guard lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for (auto& t : threads)
+		t.join();
+}
+
+void ThreadPool::Submit(stl::fnptr<void()> job)
+{
+	{
+		MAYA_STL lock_guard lock(mutex);
+		jobs.emplace_back(MAYA_STL move(job));
+		pending++;
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	MAYA_STL unique_lock lock(mutex);
+	idle.wait(lock, [this]() { return !pending; });
+}
+
+unsigned ThreadPool::GetPendingCount() const
+{
+	MAYA_STL lock_guard lock(mutex);
+	return pending;
+}
+
+void ThreadPool::Run()
+{
+	MAYA_STL unique_lock lock(mutex);
+	while (true)
+	{
+		// Queued jobs are drained before stopping.
+		wake.wait(lock, [this]() { return stop || !jobs.empty(); });
+		if (jobs.empty()) return;
+		auto job = MAYA_STL move(jobs.front());
+		jobs.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
+		if (!--pending) idle.notify_all();
+	}
+}
+
+void ParallelFor(int count, unsigned threads, stl::fnptr<void(int, int)> const& fn, int grain)
+{
+	if (!threads)
+		threads = MAYA_STL max(1u, MAYA_STL thread::hardware_concurrency());
+
+	unsigned n = MAYA_STL min(threads, static_cast<unsigned>(MAYA_STL max(count / MAYA_STL max(grain, 1), 1)));
+	if (n <= 1) {
+		if (count > 0) fn(0, count);
+		return;
+	}
+
+	int chunk = (count + n - 1) / n;
+	stl::list<MAYA_STL thread> pool;
+	pool.reserve(n - 1);
+	for (unsigned i = 1; i < n; i++) {
+		int begin = i * chunk, end = MAYA_STL min(count, begin + chunk);
+		if (begin < end) pool.emplace_back(fn, begin, end);
+	}
+
+	fn(0, MAYA_STL min(chunk, count));
+	for (auto& t : pool)
+		t.join();
+}
+
 }
\ No newline at end of file
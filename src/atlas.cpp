@@ -0,0 +1,171 @@
+#include <maya/atlas.hpp>
+#include <maya/dataio.hpp>
+#include <algorithm>
+#include <numeric>
+#include <climits>
+
+namespace maya
+{
+
+TextureAtlas::TextureAtlas(RenderContext& rc, Ivec2 pagesize, int channels, int padding)
+	: rc(&rc), pagesize(pagesize), channels(channels), padding(padding)
+{
+	pages.reserve(4);
+	regions.reserve(64);
+}
+
+TextureAtlas::uptr TextureAtlas::MakeUnique(RenderContext& rc, Ivec2 pagesize, int channels, int padding)
+{
+	return uptr(new TextureAtlas(rc, pagesize, channels, padding));
+}
+
+TextureAtlas::sptr TextureAtlas::MakeShared(RenderContext& rc, Ivec2 pagesize, int channels, int padding)
+{
+	return sptr(new TextureAtlas(rc, pagesize, channels, padding));
+}
+
+void TextureAtlas::AddPage()
+{
+	Page page;
+	page.Tex = Texture::MakeUnique(*rc);
+	page.Tex->CreateContent(nullptr, pagesize, channels);
+	page.Tex->SetClampToEdge();
+	page.Tex->SetFilterLinear();
+	page.FreeRects.push_back({ 0, 0, pagesize.x, pagesize.y });
+	pages.push_back(MAYA_STL move(page));
+}
+
+bool TextureAtlas::FindPosition(Page const& page, int w, int h, Rect& out) const
+{
+	int bestshort = INT_MAX, bestlong = INT_MAX;
+	for (auto& fr : page.FreeRects)
+	{
+		if (fr.W < w || fr.H < h)
+			continue;
+		int leftw = fr.W - w, lefth = fr.H - h;
+		int shortside = MAYA_STL min(leftw, lefth), longside = MAYA_STL max(leftw, lefth);
+		if (shortside < bestshort || (shortside == bestshort && longside < bestlong)) {
+			out = { fr.X, fr.Y, w, h };
+			bestshort = shortside;
+			bestlong = longside;
+		}
+	}
+	return bestshort != INT_MAX;
+}
+
+void TextureAtlas::PlaceRect(Page& page, Rect const& used)
+{
+	auto& frees = page.FreeRects;
+	stl::list<Rect> splits;
+
+	// Split every free rect that overlaps the used one into maximal rects.
+	for (MAYA_STL size_t i = 0; i < frees.size(); )
+	{
+		Rect fr = frees[i];
+		if (used.X >= fr.X + fr.W || used.X + used.W <= fr.X || used.Y >= fr.Y + fr.H || used.Y + used.H <= fr.Y) {
+			i++;
+			continue;
+		}
+
+		if (used.X > fr.X) splits.push_back({ fr.X, fr.Y, used.X - fr.X, fr.H });
+		if (used.X + used.W < fr.X + fr.W) splits.push_back({ used.X + used.W, fr.Y, fr.X + fr.W - used.X - used.W, fr.H });
+		if (used.Y > fr.Y) splits.push_back({ fr.X, fr.Y, fr.W, used.Y - fr.Y });
+		if (used.Y + used.H < fr.Y + fr.H) splits.push_back({ fr.X, used.Y + used.H, fr.W, fr.Y + fr.H - used.Y - used.H });
+
+		frees[i] = frees.back();
+		frees.pop_back();
+	}
+
+	frees.insert(frees.end(), splits.begin(), splits.end());
+
+	// Remove free rects contained by another.
+	auto contains = [](Rect const& a, Rect const& b) {
+		return b.X >= a.X && b.Y >= a.Y && b.X + b.W <= a.X + a.W && b.Y + b.H <= a.Y + a.H;
+	};
+
+	for (int i = 0; i < static_cast<int>(frees.size()); i++) {
+		for (int j = i + 1; j < static_cast<int>(frees.size()); j++) {
+			if (contains(frees[j], frees[i])) {
+				frees.erase(frees.begin() + i--);
+				break;
+			}
+			if (contains(frees[i], frees[j]))
+				frees.erase(frees.begin() + j--);
+		}
+	}
+}
+
+int TextureAtlas::Insert(ImageData const& image)
+{
+	if (image.Size.x <= 0 || image.Size.y <= 0 || image.Channels <= 0
+		|| image.Data.size() < static_cast<MAYA_STL size_t>(image.Size.x) * image.Size.y * image.Channels) [[unlikely]] {
+		MAYA_MAKE_ERROR(OUT_OF_BOUNDS_ERROR, "Image is empty or its data is smaller than its size and channels.");
+		return -1;
+	}
+
+	int w = image.Size.x + padding * 2, h = image.Size.y + padding * 2;
+	if (w > pagesize.x || h > pagesize.y) [[unlikely]] {
+		MAYA_MAKE_ERROR(OUT_OF_BOUNDS_ERROR, "Image is larger than a page of the texture atlas.");
+		return -1;
+	}
+
+	Rect rect;
+	int pageindex = 0, count = static_cast<int>(pages.size());
+	for (; pageindex < count; pageindex++)
+		if (FindPosition(pages[pageindex], w, h, rect)) break;
+
+	if (pageindex == count) {
+		AddPage();
+		FindPosition(pages.back(), w, h, rect);
+	}
+
+	auto& page = pages[pageindex];
+	PlaceRect(page, rect);
+
+	// Copy with the edges extruded into the padding, so that filtering does not bleed.
+	stl::list<unsigned char> pixels(static_cast<MAYA_STL size_t>(w) * h * channels);
+	int const ch = image.Channels;
+	for (int y = 0; y < h; y++) {
+		int sy = MAYA_STL clamp(y - padding, 0, image.Size.y - 1);
+		for (int x = 0; x < w; x++) {
+			int sx = MAYA_STL clamp(x - padding, 0, image.Size.x - 1);
+			unsigned char const* src = &image.Data[(static_cast<MAYA_STL size_t>(sy) * image.Size.x + sx) * ch];
+			unsigned char* dst = &pixels[(static_cast<MAYA_STL size_t>(y) * w + x) * channels];
+			for (int k = 0; k < channels; k++) {
+				if (ch <= 2 && channels >= 3) // gray expanded to color.
+					dst[k] = k < 3 ? src[0] : (ch == 2 ? src[1] : 255);
+				else
+					dst[k] = k < ch ? src[k] : (k == 3 ? 255 : 0);
+			}
+		}
+	}
+
+	page.Tex->UpdateContent(pixels.data(), Ivec2(rect.X, rect.Y), Ivec2(w, h));
+
+	Region region;
+	region.Page = pageindex;
+	region.Position = Ivec2(rect.X + padding, rect.Y + padding);
+	region.Size = image.Size;
+	region.UvMin = Fvec2(float(region.Position.x) / pagesize.x, float(region.Position.y) / pagesize.y);
+	region.UvMax = region.UvMin + Fvec2(float(region.Size.x) / pagesize.x, float(region.Size.y) / pagesize.y);
+	regions.push_back(region);
+	return static_cast<int>(regions.size() - 1);
+}
+
+stl::list<int> TextureAtlas::Insert(stl::list<ImageData> const& images)
+{
+	stl::list<int> order(images.size());
+	MAYA_STL iota(order.begin(), order.end(), 0);
+	MAYA_STL stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		auto& sa = images[a].Size;
+		auto& sb = images[b].Size;
+		return MAYA_STL max(sa.x, sa.y) > MAYA_STL max(sb.x, sb.y);
+	});
+
+	stl::list<int> ids(images.size());
+	for (int i : order)
+		ids[i] = Insert(images[i]);
+	return ids;
+}
+
+}
@@ -1,92 +1,588 @@
 #include <maya/audio.hpp>
 #include <maya/dataio.hpp>
+#include <maya/audiostream.hpp>
 #include <portaudio.h>
 #include <atomic>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <cmath>
 
 namespace maya
 {
 
+static AudioOutput::Backend s_Backend = AudioOutput::DEVICE_BACKEND;
+
+// Written by the callback and read by any thread, each counter on its own, so a snapshot may straddle a callback.
+struct AudioOutputCounters
+{
+	stl::array<stl::atomic<MAYA_STL uint64_t>, AudioStats::LoadBins> Load;
+	stl::atomic<MAYA_STL uint64_t> Callbacks, Underflows, Overflows;
+
+	// In nanoseconds.
+	stl::atomic<MAYA_STL uint64_t> TotalTime, MaxTime, BufferTime;
+};
+
+// Adapts the PortAudio callback to the output callback.
+struct AudioOutputDevice
+{
+	static int Callback(const void* input_buffer, void* output_buffer,
+						unsigned long frames_per_buffer,
+						const PaStreamCallbackTimeInfo* time_info,
+						PaStreamCallbackFlags status_flags,
+						void* userdata)
+	{
+		AudioOutput* output = static_cast<AudioOutput*>(userdata);
+		bool more = output->Run(static_cast<float*>(output_buffer), static_cast<unsigned>(frames_per_buffer),
+			(status_flags & paOutputUnderflow) != 0, (status_flags & paOutputOverflow) != 0);
+		return more ? paContinue : paComplete;
+	}
+};
+
+float AudioStats::GetLoadPercentile(float p) const
+{
+	if (!Callbacks)
+		return 0;
+	MAYA_STL uint64_t want = static_cast<MAYA_STL uint64_t>(MAYA_STL ceil(MAYA_STL clamp(p, 0.0f, 1.0f) * Callbacks)), seen = 0;
+	for (unsigned i = 0; i < LoadBins; i++) {
+		seen += Load[i];
+		if (seen >= want)
+			return (i + 1) / 16.0f;
+	}
+	return LoadBins / 16.0f;
+}
+
+void AudioOutput::SetBackend(Backend backend)
+{
+	s_Backend = backend;
+}
+
+AudioOutput::Backend AudioOutput::GetBackend()
+{
+	return s_Backend;
+}
+
+AudioOutput::AudioOutput()
+	: nativeptr(0), backend(DEVICE_BACKEND), callback(0), userdata(0), channels(0), samplerate(0), framesperbuffer(0), active(false),
+	adaptive(false), adaptframes(0), minframes(0), maxframes(0), mark()
+{
+	counters = MAYA_STL make_unique<AudioOutputCounters>();
+	ResetStats();
+}
+
+AudioOutput::~AudioOutput()
+{
+	Close();
+}
+
+bool AudioOutput::Open(unsigned channels, unsigned samplerate, unsigned framesperbuffer, Callback callback, void* userdata)
+{
+	Close();
+	if (samplerate != this->samplerate)
+		adaptframes = minframes = 0;
+	this->backend = s_Backend;
+	this->channels = channels;
+	this->samplerate = samplerate;
+	this->framesperbuffer = framesperbuffer;
+	this->userdata = userdata;
+	active = false;
+	ResetStats();
+
+	if (backend == OFFLINE_BACKEND) {
+		this->callback = callback;
+		return true;
+	}
+
+	if (!OpenDevice())
+		return false;
+	this->callback = callback;
+	return true;
+}
+
+bool AudioOutput::OpenDevice()
+{
+	PaStreamParameters outputParameters;
+	outputParameters.device = Pa_GetDefaultOutputDevice();
+	if (outputParameters.device == paNoDevice) {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "No audio output device is available");
+		return false;
+	}
+	PaTime low = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
+
+	// Adaptive outputs start from the largest power of two within the low latency of the device,
+	// and ask the host for no more latency than one buffer above that.
+	if (adaptive) {
+		if (!minframes) {
+			unsigned frames = static_cast<unsigned>(low * samplerate);
+			minframes = 32;
+			while (minframes * 2 <= frames && minframes * 2 <= maxframes)
+				minframes *= 2;
+		}
+		if (!adaptframes)
+			adaptframes = minframes;
+		framesperbuffer = adaptframes;
+		low = MAYA_STL max(low, static_cast<PaTime>(framesperbuffer) / samplerate);
+	}
+
+	outputParameters.channelCount = channels;
+	outputParameters.sampleFormat = paFloat32;
+	outputParameters.suggestedLatency = low;
+	outputParameters.hostApiSpecificStreamInfo = NULL;
+
+	PaStream* stream;
+	PaError err = Pa_OpenStream(&stream, NULL, &outputParameters, samplerate, framesperbuffer,
+		paNoFlag, AudioOutputDevice::Callback, this);
+	if (err != paNoError) {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "Unable to open audio output: " + stl::string(Pa_GetErrorText(err)));
+		return false;
+	}
+	nativeptr = stream;
+	mark = GetStats();
+	return true;
+}
+
+void AudioOutput::Close()
+{
+	if (nativeptr)
+		Pa_CloseStream(static_cast<PaStream*>(nativeptr));
+	nativeptr = 0;
+	callback = 0;
+	active = false;
+}
+
+void AudioOutput::Start()
+{
+	if (!callback)
+		return;
+	if (backend == OFFLINE_BACKEND) {
+		active = true;
+		return;
+	}
+	PaStream* stream = static_cast<PaStream*>(nativeptr);
+	if (Pa_IsStreamActive(stream) == 1)
+		return;
+	// A stream whose source has ended is still to be stopped before it can start again.
+	if (Pa_IsStreamStopped(stream) == 0)
+		Pa_StopStream(stream);
+	Pa_StartStream(stream);
+}
+
+void AudioOutput::Stop()
+{
+	active = false;
+	if (nativeptr)
+		Pa_StopStream(static_cast<PaStream*>(nativeptr));
+}
+
+bool AudioOutput::IsOpen() const
+{
+	return callback != 0;
+}
+
+bool AudioOutput::IsActive() const
+{
+	if (backend == OFFLINE_BACKEND)
+		return active;
+	return nativeptr && Pa_IsStreamActive(static_cast<PaStream*>(nativeptr)) == 1;
+}
+
+bool AudioOutput::IsConcurrent() const
+{
+	return backend == DEVICE_BACKEND && IsActive();
+}
+
+unsigned AudioOutput::Render(float* out, unsigned frames)
+{
+	if (backend != OFFLINE_BACKEND)
+		return 0;
+	unsigned done = 0, block = framesperbuffer ? framesperbuffer : 0x200;
+	while (done < frames && active)
+	{
+		unsigned n = MAYA_STL min(block, frames - done);
+		if (!Run(out + done * channels, n, false, false))
+			active = false;
+		done += n;
+	}
+	return done;
+}
+
+bool AudioOutput::Run(float* out, unsigned frames, bool underflow, bool overflow)
+{
+	auto start = MAYA_STL chrono::steady_clock::now();
+	bool more = callback(userdata, out, frames);
+	MAYA_STL uint64_t time = static_cast<MAYA_STL uint64_t>(
+		MAYA_STL chrono::duration_cast<MAYA_STL chrono::nanoseconds>(MAYA_STL chrono::steady_clock::now() - start).count());
+
+	// Only this thread raises the maximum, so a plain compare suffices.
+	AudioOutputCounters& c = *counters;
+	MAYA_STL uint64_t period = samplerate ? static_cast<MAYA_STL uint64_t>(frames) * 1000000000u / samplerate : 0;
+	unsigned bin = period ? static_cast<unsigned>(MAYA_STL min<MAYA_STL uint64_t>(time * 16 / period, AudioStats::LoadBins - 1)) : 0;
+	c.Load[bin].fetch_add(1, MAYA_STL memory_order_relaxed);
+	c.Callbacks.fetch_add(1, MAYA_STL memory_order_relaxed);
+	if (underflow) c.Underflows.fetch_add(1, MAYA_STL memory_order_relaxed);
+	if (overflow) c.Overflows.fetch_add(1, MAYA_STL memory_order_relaxed);
+	c.TotalTime.fetch_add(time, MAYA_STL memory_order_relaxed);
+	if (time > c.MaxTime.load(MAYA_STL memory_order_relaxed))
+		c.MaxTime.store(time, MAYA_STL memory_order_relaxed);
+	c.BufferTime.store(period, MAYA_STL memory_order_relaxed);
+	return more;
+}
+
+AudioStats AudioOutput::GetStats() const
+{
+	AudioOutputCounters const& c = *counters;
+	AudioStats stats;
+	for (unsigned i = 0; i < AudioStats::LoadBins; i++)
+		stats.Load[i] = c.Load[i].load(MAYA_STL memory_order_relaxed);
+	stats.Callbacks = c.Callbacks.load(MAYA_STL memory_order_relaxed);
+	stats.Underflows = c.Underflows.load(MAYA_STL memory_order_relaxed);
+	stats.Overflows = c.Overflows.load(MAYA_STL memory_order_relaxed);
+	MAYA_STL uint64_t total = c.TotalTime.load(MAYA_STL memory_order_relaxed);
+	stats.AverageTime = stats.Callbacks ? total / 1000.0f / stats.Callbacks : 0;
+	stats.MaxTime = c.MaxTime.load(MAYA_STL memory_order_relaxed) / 1000.0f;
+	stats.BufferTime = c.BufferTime.load(MAYA_STL memory_order_relaxed) / 1000.0f;
+	return stats;
+}
+
+void AudioOutput::ResetStats()
+{
+	AudioOutputCounters& c = *counters;
+	for (auto& bin : c.Load)
+		bin.store(0, MAYA_STL memory_order_relaxed);
+	c.Callbacks = 0;
+	c.Underflows = 0;
+	c.Overflows = 0;
+	c.TotalTime = 0;
+	c.MaxTime = 0;
+	c.BufferTime = 0;
+}
+
+void AudioOutput::SetAdaptive(bool adaptive, unsigned maxframes)
+{
+	this->adaptive = adaptive;
+	this->maxframes = MAYA_STL max(maxframes, 32u);
+	adaptframes = 0;
+	minframes = 0;
+}
+
+bool AudioOutput::Adapt()
+{
+	if (!adaptive || backend != DEVICE_BACKEND || !nativeptr || !IsActive())
+		return false;
+
+	// Counts are taken over a window since the last change, restarted if the stats were reset.
+	AudioStats now = GetStats();
+	if (now.Callbacks < mark.Callbacks)
+		mark = now;
+	MAYA_STL uint64_t calls = now.Callbacks - mark.Callbacks, underflows = now.Underflows - mark.Underflows;
+	MAYA_STL uint64_t busy = 0, late = 0;
+	for (unsigned i = 8; i < AudioStats::LoadBins; i++) {
+		MAYA_STL uint64_t n = now.Load[i] - mark.Load[i];
+		busy += n;
+		if (i >= 12) late += n;
+	}
+	double seconds = static_cast<double>(calls) * framesperbuffer / samplerate;
+
+	// Grow at once on an underflow, or if over 1% of at least 100 callbacks used three quarters of their buffer,
+	// so that the slow first callbacks after a reopen do not count as a trend.
+	// Shrink after ten seconds with no underflow and at most 1% of callbacks over half their buffer.
+	// Sizes that underflowed become the floor, so the size does not swing back into them.
+	// Right after adapting is enabled, the device is reopened at its lowest latency.
+	unsigned next = adaptframes;
+	if (next) {
+		if ((underflows || (calls >= 100 && late * 100 > calls)) && next < maxframes) {
+			next = MAYA_STL min(next * 2, maxframes);
+			if (underflows) minframes = next;
+		}
+		else if (seconds >= 10 && !underflows && busy * 100 <= calls && next / 2 >= minframes)
+			next /= 2;
+		else {
+			if (seconds >= 10) mark = now;
+			if (next == framesperbuffer)
+				return false;
+		}
+	}
+
+	// Queued buffers play out before the stream closes, and the new one starts straight away.
+	unsigned previous = framesperbuffer;
+	adaptframes = next;
+	PaStream* stream = static_cast<PaStream*>(nativeptr);
+	Pa_StopStream(stream);
+	Pa_CloseStream(stream);
+	nativeptr = 0;
+	if (!OpenDevice()) {
+		Close();
+		return false;
+	}
+	Pa_StartStream(static_cast<PaStream*>(nativeptr));
+	return framesperbuffer != previous;
+}
+
+bool AudioOutput::RenderToFile(char const* path, MAYA_STL uint64_t frames)
+{
+	if (backend != OFFLINE_BACKEND)
+		return false;
+	std::ofstream ofs(path, std::ios::binary);
+	if (!ofs.is_open()) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR, "Unable to open file: " + stl::string(path));
+		return false;
+	}
+
+	// RIFF and data sizes are filled in once the length is known.
+	unsigned char header[44] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0, 3, 0 };
+	auto put = [&header](int at, uint32_t v, int bytes) {
+		for (int i = 0; i < bytes; i++) header[at + i] = static_cast<unsigned char>(v >> (i * 8));
+	};
+	put(22, channels, 2);
+	put(24, samplerate, 4);
+	put(28, samplerate * channels * 4, 4);
+	put(32, channels * 4, 2);
+	put(34, 32, 2);
+	MAYA_STL memcpy(header + 36, "data", 4);
+	ofs.write(reinterpret_cast<char const*>(header), sizeof(header));
+
+	stl::list<float> buffer(static_cast<MAYA_STL size_t>(MAYA_STL max(framesperbuffer, 0x200u)) * channels);
+	unsigned block = static_cast<unsigned>(buffer.size() / channels);
+	MAYA_STL uint64_t written = 0;
+	while (written < frames && active)
+	{
+		unsigned n = Render(buffer.data(), static_cast<unsigned>(MAYA_STL min<MAYA_STL uint64_t>(block, frames - written)));
+		ofs.write(reinterpret_cast<char const*>(buffer.data()), static_cast<MAYA_STL streamsize>(n) * channels * sizeof(float));
+		written += n;
+	}
+
+	uint32_t bytes = static_cast<uint32_t>(written * channels * sizeof(float));
+	put(4, 36 + bytes, 4);
+	put(40, bytes, 4);
+	ofs.seekp(0);
+	ofs.write(reinterpret_cast<char const*>(header), sizeof(header));
+	return static_cast<bool>(ofs);
+}
+
 struct AudioStatus
 {
+	// Set by the API, the callback follows through commands.
 	AudioData const* Source;
-	unsigned FramesPerBuffer;
-	std::atomic<unsigned> SamplePosition;
-	std::atomic<float> Volume;
+	AudioStream* Stream;
+	float Volume;
+	AudioCommandQueue Commands{ 0x100 };
+	unsigned Swaps;
+	MAYA_STL uint64_t CommandTime;
+
+	// Owned by the callback while the stream is open, the atomics are read back by the API.
+	AudioData const* PlayingSource;
+	AudioStream* PlayingStream;
+	float PlayingVolume;
+	std::atomic<unsigned> SamplePosition, SwapsApplied;
+	std::atomic<MAYA_STL uint64_t> Clock;
 };
 
-static int s_AudioOutputCallback(const void* input_buffer, void* output_buffer,
-								unsigned long frames_per_buffer,
-								const PaStreamCallbackTimeInfo* time_info,
-								PaStreamCallbackFlags status_flags,
-								void* userdata)
+static void s_ApplyCommand(AudioStatus* status, AudioCommand const& cmd)
 {
-	float* out = static_cast<float*>(output_buffer);
-	AudioStatus* status = static_cast<AudioStatus*>(userdata);
-	unsigned int remaining = static_cast<unsigned>(status->Source->Samples.size() - status->SamplePosition);
+	switch (cmd.Kind)
+	{
+	case AudioCommand::SEEK:
+		if (status->PlayingStream)
+			status->PlayingStream->Seek(cmd.Position);
+		else if (status->PlayingSource)
+			status->SamplePosition.store(static_cast<unsigned>(cmd.Position * status->PlayingSource->Channels), std::memory_order_relaxed);
+		break;
+	case AudioCommand::SET_GAIN:
+		status->PlayingVolume = cmd.Gain;
+		break;
+	case AudioCommand::SET_SOURCE:
+		status->PlayingSource = cmd.Data;
+		status->PlayingStream = cmd.Stream;
+		status->SamplePosition.store(0, std::memory_order_relaxed);
+		status->SwapsApplied.fetch_add(1, std::memory_order_release);
+		break;
+	default:
+		break;
+	}
+}
 
-	if (remaining >= frames_per_buffer * status->Source->Channels)
+static void s_ApplyPending(AudioStatus* status)
+{
+	while (AudioCommand const* cmd = status->Commands.Peek()) {
+		s_ApplyCommand(status, *cmd);
+		status->Commands.Pop();
+	}
+}
+
+// Render frames of the playing source, returns false once its end is reached.
+static bool s_RenderSource(AudioStatus* status, float* out, unsigned frames_per_buffer)
+{
+	float volume = status->PlayingVolume;
+
+	if (AudioStream* stream = status->PlayingStream)
 	{
-		unsigned pos = status->SamplePosition;
-		for (unsigned int i = 0; i < frames_per_buffer * status->Source->Channels; i++)
-			out[i] = status->Source->Samples[pos++] * status->Volume;
-		status->SamplePosition = pos;
-		return paContinue;
+		// A stream behind on decoding is padded with silence rather than waited for.
+		unsigned channels = stream->GetChannels();
+		unsigned count = stream->Read(out, static_cast<unsigned>(frames_per_buffer)) * channels;
+		for (unsigned i = 0; i < count; i++)
+			out[i] *= volume;
+		std::fill(out + count, out + frames_per_buffer * channels, 0.0f);
+		return !stream->IsEndReached();
 	}
 
+	// Encoded sources are decoded straight into the output.
+	AudioData const* source = status->PlayingSource;
+	unsigned channels = source->Channels;
+	unsigned total = static_cast<unsigned>(frames_per_buffer * channels);
+	unsigned pos = MAYA_STL min(status->SamplePosition.load(std::memory_order_relaxed), static_cast<unsigned>(source->GetFrameCount() * channels));
+	unsigned count = static_cast<unsigned>(source->Decode(out, pos / channels, frames_per_buffer)) * channels;
+
+	for (unsigned i = 0; i < count; i++)
+		out[i] *= volume;
+	status->SamplePosition.store(pos + count, std::memory_order_relaxed);
+
 	// The end is reached. Play the remaining samples.
-	unsigned pos = status->SamplePosition;
-	for (unsigned int i = 0; i < remaining; i++)
-		out[i] = status->Source->Samples[pos++] * status->Volume;
-	status->SamplePosition = pos;
+	if (count < total) {
+		std::fill(out + count, out + total, 0.0f);
+		return false;
+	}
+	return true;
+}
+
+static bool s_AudioOutputCallback(void* userdata, float* out, unsigned frames_per_buffer)
+{
+	AudioStatus* status = static_cast<AudioStatus*>(userdata);
 
-	return paComplete;
+	// The buffer is split at the frame of each command, so that commands apply sample accurately.
+	MAYA_STL uint64_t clock = status->Clock.load(std::memory_order_relaxed);
+	unsigned pos = 0;
+	bool playing = true;
+	while (pos < frames_per_buffer)
+	{
+		unsigned end = frames_per_buffer;
+		while (AudioCommand const* cmd = status->Commands.Peek())
+		{
+			if (cmd->Frame > clock + pos) {
+				end = static_cast<unsigned>(MAYA_STL min<MAYA_STL uint64_t>(frames_per_buffer, cmd->Frame - clock));
+				break;
+			}
+			s_ApplyCommand(status, *cmd);
+			status->Commands.Pop();
+		}
+		unsigned channels = status->PlayingStream ? status->PlayingStream->GetChannels() : status->PlayingSource->Channels;
+		playing = s_RenderSource(status, out + pos * channels, end - pos);
+		pos = end;
+	}
+
+	status->Clock.store(clock + frames_per_buffer, std::memory_order_relaxed);
+	return playing;
 }
 
 AudioPlayer::AudioPlayer()
-	: nativeptr(0)
 {
 	status = std::make_unique<AudioStatus>();
 	status->Source = 0;
+	status->Stream = 0;
 	status->Volume = 1.f;
+	status->Swaps = 0;
+	status->PlayingSource = 0;
+	status->PlayingStream = 0;
+	status->PlayingVolume = 1.f;
+	status->SamplePosition = 0;
+	status->SwapsApplied = 0;
+	status->CommandTime = 0;
+	status->Clock = 0;
 }
 
 AudioPlayer::~AudioPlayer()
 {
-	if (nativeptr)
-		Pa_CloseStream(static_cast<PaStream*>(nativeptr));
+	output.Close();
 }
 
-void AudioPlayer::SetSource(AudioData const* src, unsigned framesperbuffer)
+// Queue a command for the callback at the current command time. While the callback cannot be running alongside,
+// a command already due with none queued before it is applied here instead.
+static void s_Send(AudioOutput& output, AudioStatus* status, AudioCommand cmd)
 {
-	if (status->Source == src)
+	cmd.Frame = status->CommandTime;
+	if (!output.IsConcurrent() && cmd.Frame <= status->Clock.load(std::memory_order_relaxed) && !status->Commands.Peek()) {
+		s_ApplyCommand(status, cmd);
 		return;
-
-	if (nativeptr) {
-		Pa_CloseStream(static_cast<PaStream*>(nativeptr));
 	}
+	while (!status->Commands.Push(cmd)) {
+		// Nothing drains a full queue while the callback is not running, so the waiting commands apply early.
+		if (!output.IsConcurrent()) s_ApplyPending(status);
+		else std::this_thread::yield();
+	}
+}
 
-	if (!src) {
-		nativeptr = 0;
-		status->Source = 0;
+// Swap the source through the callback, returning once it no longer reads the previous one.
+static void s_SwapSource(AudioOutput& output, AudioStatus* status, AudioData const* data, AudioStream* stream)
+{
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::SET_SOURCE;
+	cmd.Data = data;
+	cmd.Stream = stream;
+	unsigned target = ++status->Swaps;
+
+	// The previous source must not be read once this returns, so the swap is never timed. While the callback
+	// is not running, commands still waiting for their time are applied first.
+	if (!output.IsConcurrent()) {
+		s_ApplyPending(status);
+		s_ApplyCommand(status, cmd);
 		return;
 	}
+	while (!status->Commands.Push(cmd))
+		std::this_thread::yield();
+	while (status->SwapsApplied.load(std::memory_order_acquire) != target && output.IsConcurrent())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
 
-	PaStreamParameters outputParameters;
-	outputParameters.device = Pa_GetDefaultOutputDevice();
-	outputParameters.channelCount = src->Channels;
-	outputParameters.sampleFormat = paFloat32;
-	outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
-	outputParameters.hostApiSpecificStreamInfo = NULL;
+// Reopen the output for a source of a different layout.
+static void s_ReopenOutput(AudioOutput& output, AudioStatus* status, unsigned channels, unsigned samplerate, unsigned framesperbuffer)
+{
+	output.Close();
+	s_SwapSource(output, status, status->Source, status->Stream);
+	if (status->Source || status->Stream)
+		output.Open(channels, samplerate, framesperbuffer, s_AudioOutputCallback, status);
+}
+
+void AudioPlayer::SetSource(AudioData const* src, unsigned framesperbuffer)
+{
+	if (status->Source == src && !status->Stream)
+		return;
 
 	status->Source = src;
-	status->SamplePosition = 0;
-	status->FramesPerBuffer = framesperbuffer;
+	status->Stream = 0;
 
-	PaStream* stream;
-	Pa_OpenStream(&stream, NULL, &outputParameters, src->SampleRate, framesperbuffer,
-		paNoFlag, s_AudioOutputCallback, status.get());
+	// A source of the same layout is swapped in by the callback, without reopening the device.
+	if (src && output.IsOpen() && src->Channels == output.GetChannels() && src->SampleRate == output.GetSampleRate()
+		&& (framesperbuffer == output.GetFramesPerBuffer() || output.IsAdaptive())) {
+		s_SwapSource(output, status.get(), src, 0);
+		return;
+	}
 
-	nativeptr = stream;
+	if (src) s_ReopenOutput(output, status.get(), src->Channels, src->SampleRate, framesperbuffer);
+	else s_ReopenOutput(output, status.get(), 0, 0, 0);
+}
+
+void AudioPlayer::SetSource(AudioStream* src, unsigned framesperbuffer)
+{
+	if (status->Stream == src)
+		return;
+	if (src && !src->GetChannels()) [[unlikely]] {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "The audio stream is not open.");
+		return;
+	}
+
+	status->Source = 0;
+	status->Stream = src;
+
+	if (src && output.IsOpen() && src->GetChannels() == output.GetChannels() && src->GetSampleRate() == output.GetSampleRate()
+		&& (framesperbuffer == output.GetFramesPerBuffer() || output.IsAdaptive())) {
+		s_SwapSource(output, status.get(), 0, src);
+		return;
+	}
+
+	if (src) s_ReopenOutput(output, status.get(), src->GetChannels(), src->GetSampleRate(), framesperbuffer);
+	else s_ReopenOutput(output, status.get(), 0, 0, 0);
 }
 
 AudioData const* AudioPlayer::GetSource() const
@@ -94,14 +590,23 @@ AudioData const* AudioPlayer::GetSource() const
 	return status->Source;
 }
 
+AudioStream* AudioPlayer::GetStream() const
+{
+	return status->Stream;
+}
+
 unsigned AudioPlayer::GetFramesPerBuffer() const
 {
-	return status->FramesPerBuffer;
+	return output.GetFramesPerBuffer();
 }
 
 void AudioPlayer::SetVolume(float vol)
 {
 	status->Volume = vol;
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::SET_GAIN;
+	cmd.Gain = vol;
+	s_Send(output, status.get(), cmd);
 }
 
 float AudioPlayer::GetVolume() const
@@ -111,42 +616,59 @@ float AudioPlayer::GetVolume() const
 
 void AudioPlayer::Start(float pos)
 {
-	status->SamplePosition = static_cast<unsigned>(pos * status->Source->SampleRate * status->Source->Channels);
-	if (!IsPlaying())
-		Pa_StartStream(static_cast<PaStream*>(nativeptr));
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::SEEK;
+	cmd.Position = static_cast<MAYA_STL uint64_t>(pos * output.GetSampleRate());
+	s_Send(output, status.get(), cmd);
+	output.Start();
+}
+
+void AudioPlayer::SetCommandTime(MAYA_STL uint64_t frame)
+{
+	status->CommandTime = frame;
+}
+
+MAYA_STL uint64_t AudioPlayer::GetClock() const
+{
+	return status->Clock.load(std::memory_order_relaxed);
 }
 
 void AudioPlayer::Resume()
 {
-	if (!IsPlaying())
-		Pa_StartStream(static_cast<PaStream*>(nativeptr));
+	output.Start();
 }
 
 void AudioPlayer::Stop()
 {
-	Pa_StopStream(static_cast<PaStream*>(nativeptr));
+	output.Stop();
 }
 
 bool AudioPlayer::IsPlaying() const
 {
-	return Pa_IsStreamActive(static_cast<PaStream*>(nativeptr));
+	return output.IsActive();
 }
 
 float AudioPlayer::GetPosition() const
 {
+	if (auto* stream = status->Stream)
+		return (float) stream->GetPosition() / stream->GetSampleRate();
 	auto& src = status->Source;
 	return (float) status->SamplePosition / src->SampleRate / src->Channels;
 }
 
 float AudioPlayer::GetDuration() const
 {
+	if (auto* stream = status->Stream)
+		return (float) stream->GetFrameCount() / stream->GetSampleRate();
 	auto& src = status->Source;
-	return (float) src->Samples.size() / src->SampleRate / src->Channels;
+	return (float) src->GetFrameCount() / src->SampleRate;
 }
 
 bool AudioPlayer::IsEndReached() const
 {
-	return status->SamplePosition == status->Source->Samples.size();
+	if (status->Stream)
+		return status->Stream->IsEndReached();
+	return status->SamplePosition == status->Source->GetFrameCount() * status->Source->Channels;
 }
 
 }
\ No newline at end of file
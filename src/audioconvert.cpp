@@ -0,0 +1,592 @@
+#include <maya/audioconvert.hpp>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define MAYA_AUDIO_AVX2 1
+#include <immintrin.h>
+#else
+#define MAYA_AUDIO_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYA_AUDIO_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYA_AUDIO_SSE2 0
+#endif
+
+#if !MAYA_AUDIO_SSE2 && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#define MAYA_AUDIO_NEON 1
+#include <arm_neon.h>
+#else
+#define MAYA_AUDIO_NEON 0
+#endif
+
+namespace maya
+{
+
+static int32_t s_Load32(unsigned char const* p)
+{
+	int32_t x;
+	MAYA_STL memcpy(&x, p, 4);
+	return x;
+}
+
+// Sign extend the 24-bit sample at p.
+static int32_t s_Load24(unsigned char const* p)
+{
+	return static_cast<int32_t>((p[0] << 8) | (p[1] << 16) | (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+}
+
+unsigned GetSampleSize(SampleFormat format)
+{
+	switch (format)
+	{
+		case U8_SAMPLE: case S8_SAMPLE: return 1;
+		case S16_SAMPLE: return 2;
+		case S24_SAMPLE: return 3;
+		case S32_SAMPLE: case F32_SAMPLE: return 4;
+		case F64_SAMPLE: return 8;
+	}
+	return 0;
+}
+
+static void s_Int8ToFloat(float* dst, unsigned char const* src, MAYA_STL size_t count, unsigned char bias)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_SSE2
+	__m128i flip = _mm_set1_epi8(static_cast<char>(bias));
+	__m128 scale = _mm_set1_ps(1.0f / 128.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i)), flip);
+		__m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+		__m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), scale));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), scale));
+		_mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), scale));
+		_mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), scale));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 16 <= count; i += 16)
+	{
+		int8x16_t x = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(src + i), vdupq_n_u8(bias)));
+		int16x8_t lo = vmovl_s8(vget_low_s8(x)), hi = vmovl_s8(vget_high_s8(x));
+		vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), 1.0f / 128.0f));
+		vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), 1.0f / 128.0f));
+		vst1q_f32(dst + i + 8, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), 1.0f / 128.0f));
+		vst1q_f32(dst + i + 12, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), 1.0f / 128.0f));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = static_cast<int8_t>(src[i] ^ bias) * (1.0f / 128.0f);
+}
+
+static void s_Int16ToFloat(float* dst, unsigned char const* src, MAYA_STL size_t count)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_AVX2
+	__m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 2)));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 2 + 16)));
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+		_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+	}
+#endif
+#if MAYA_AUDIO_SSE2
+	__m128 scale4 = _mm_set1_ps(1.0f / 32768.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 2));
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), scale4));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), scale4));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 8 <= count; i += 8)
+	{
+		int16x8_t x = vreinterpretq_s16_u8(vld1q_u8(src + i * 2));
+		vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.0f / 32768.0f));
+		vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1.0f / 32768.0f));
+	}
+#endif
+	for (; i < count; i++) {
+		int16_t x;
+		MAYA_STL memcpy(&x, src + i * 2, 2);
+		dst[i] = x * (1.0f / 32768.0f);
+	}
+}
+
+static void s_Int24ToFloat(float* dst, unsigned char const* src, MAYA_STL size_t count)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_SSE2
+	// Each lane loads 4 bytes and drops the one above its sample, so a block stops one sample short of the end.
+	__m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	for (; i + 5 <= count; i += 4)
+	{
+		unsigned char const* p = src + i * 3;
+		__m128i x = _mm_setr_epi32(s_Load32(p), s_Load32(p + 3), s_Load32(p + 6), s_Load32(p + 9));
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_slli_epi32(x, 8)), scale));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 8 <= count; i += 8)
+	{
+		// Bytes are placed in the top 24 bits, so the sign lands in the sign bit.
+		uint8x8x3_t b = vld3_u8(src + i * 3);
+		uint16x8_t b0 = vmovl_u8(b.val[0]), b1 = vmovl_u8(b.val[1]), b2 = vmovl_u8(b.val[2]);
+		int32x4_t lo = vreinterpretq_s32_u32(vorrq_u32(vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(b2)), 24),
+			vshlq_n_u32(vmovl_u16(vget_low_u16(b1)), 16)), vshlq_n_u32(vmovl_u16(vget_low_u16(b0)), 8)));
+		int32x4_t hi = vreinterpretq_s32_u32(vorrq_u32(vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(b2)), 24),
+			vshlq_n_u32(vmovl_u16(vget_high_u16(b1)), 16)), vshlq_n_u32(vmovl_u16(vget_high_u16(b0)), 8)));
+		vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(lo), 1.0f / 2147483648.0f));
+		vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(hi), 1.0f / 2147483648.0f));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = s_Load24(src + i * 3) * (1.0f / 8388608.0f);
+}
+
+static void s_Int32ToFloat(float* dst, unsigned char const* src, MAYA_STL size_t count)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_SSE2
+	__m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 4))), scale));
+#elif MAYA_AUDIO_NEON
+	for (; i + 4 <= count; i += 4)
+		vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u8(vld1q_u8(src + i * 4))), 1.0f / 2147483648.0f));
+#endif
+	for (; i < count; i++)
+		dst[i] = s_Load32(src + i * 4) * (1.0f / 2147483648.0f);
+}
+
+static void s_DoubleToFloat(float* dst, unsigned char const* src, MAYA_STL size_t count)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<double const*>(src + i * 8)));
+		__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<double const*>(src + i * 8 + 16)));
+		_mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 2 <= count; i += 2)
+		vst1_f32(dst + i, vcvt_f32_f64(vreinterpretq_f64_u8(vld1q_u8(src + i * 8))));
+#endif
+	for (; i < count; i++) {
+		double x;
+		MAYA_STL memcpy(&x, src + i * 8, 8);
+		dst[i] = static_cast<float>(x);
+	}
+}
+
+void ConvertToFloat(float* dst, void const* src, SampleFormat format, MAYA_STL size_t count)
+{
+	auto* bytes = static_cast<unsigned char const*>(src);
+	switch (format)
+	{
+		case U8_SAMPLE: s_Int8ToFloat(dst, bytes, count, 0x80); break;
+		case S8_SAMPLE: s_Int8ToFloat(dst, bytes, count, 0); break;
+		case S16_SAMPLE: s_Int16ToFloat(dst, bytes, count); break;
+		case S24_SAMPLE: s_Int24ToFloat(dst, bytes, count); break;
+		case S32_SAMPLE: s_Int32ToFloat(dst, bytes, count); break;
+		case F32_SAMPLE: MAYA_STL memcpy(dst, src, count * sizeof(float)); break;
+		case F64_SAMPLE: s_DoubleToFloat(dst, bytes, count); break;
+	}
+}
+
+// Scale, round and clamp to the signed range of bits, the largest float below 2^31 bounds 32 bits.
+static int32_t s_FloatToInt(float x, int bits)
+{
+	float scale = static_cast<float>(1u << (bits - 1));
+	float y = MAYA_STL clamp(x * scale, -scale, bits == 32 ? 2147483520.0f : scale - 1);
+	return static_cast<int32_t>(y < 0 ? y - 0.5f : y + 0.5f);
+}
+
+static void s_FloatToInt8(unsigned char* dst, float const* src, MAYA_STL size_t count, unsigned char bias)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_SSE2
+	__m128 scale = _mm_set1_ps(128.0f);
+	__m128i flip = _mm_set1_epi8(static_cast<char>(bias));
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scale));
+		__m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale));
+		__m128i c = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 8), scale));
+		__m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 12), scale));
+		__m128i x = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(x, flip));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 8 <= count; i += 8)
+	{
+		int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 128.0f));
+		int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 128.0f));
+		int8x8_t x = vqmovn_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+		vst1_u8(dst + i, veor_u8(vreinterpret_u8_s8(x), vdup_n_u8(bias)));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = static_cast<unsigned char>(s_FloatToInt(src[i], 8)) ^ bias;
+}
+
+static void s_FloatToInt16(unsigned char* dst, float const* src, MAYA_STL size_t count)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_AVX2
+	__m256 scale = _mm256_set1_ps(32768.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale));
+		__m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale));
+		// Packing works within 128-bit lanes, so the quarters are put back in order afterwards.
+		__m256i x = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), x);
+	}
+#endif
+#if MAYA_AUDIO_SSE2
+	__m128 scale4 = _mm_set1_ps(32768.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scale4));
+		__m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_packs_epi32(a, b));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 8 <= count; i += 8)
+	{
+		int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f));
+		int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f));
+		vst1q_u8(dst + i * 2, vreinterpretq_u8_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b))));
+	}
+#endif
+	for (; i < count; i++) {
+		int16_t x = static_cast<int16_t>(s_FloatToInt(src[i], 16));
+		MAYA_STL memcpy(dst + i * 2, &x, 2);
+	}
+}
+
+static void s_FloatToInt32(unsigned char* dst, float const* src, MAYA_STL size_t count)
+{
+	MAYA_STL size_t i = 0;
+#if MAYA_AUDIO_SSE2
+	__m128 scale = _mm_set1_ps(2147483648.0f);
+	__m128 lo = _mm_set1_ps(-2147483648.0f), hi = _mm_set1_ps(2147483520.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_cvtps_epi32(x));
+	}
+#elif MAYA_AUDIO_NEON
+	for (; i + 4 <= count; i += 4)
+		vst1q_u8(dst + i * 4, vreinterpretq_u8_s32(vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 2147483648.0f))));
+#endif
+	for (; i < count; i++) {
+		int32_t x = s_FloatToInt(src[i], 32);
+		MAYA_STL memcpy(dst + i * 4, &x, 4);
+	}
+}
+
+static void s_FloatToInt24(unsigned char* dst, float const* src, MAYA_STL size_t count)
+{
+	for (MAYA_STL size_t i = 0; i < count; i++) {
+		int32_t x = s_FloatToInt(src[i], 24);
+		dst[i * 3] = static_cast<unsigned char>(x);
+		dst[i * 3 + 1] = static_cast<unsigned char>(x >> 8);
+		dst[i * 3 + 2] = static_cast<unsigned char>(x >> 16);
+	}
+}
+
+void ConvertFromFloat(void* dst, float const* src, SampleFormat format, MAYA_STL size_t count)
+{
+	auto* bytes = static_cast<unsigned char*>(dst);
+	switch (format)
+	{
+		case U8_SAMPLE: s_FloatToInt8(bytes, src, count, 0x80); break;
+		case S8_SAMPLE: s_FloatToInt8(bytes, src, count, 0); break;
+		case S16_SAMPLE: s_FloatToInt16(bytes, src, count); break;
+		case S24_SAMPLE: s_FloatToInt24(bytes, src, count); break;
+		case S32_SAMPLE: s_FloatToInt32(bytes, src, count); break;
+		case F32_SAMPLE: MAYA_STL memcpy(dst, src, count * sizeof(float)); break;
+		case F64_SAMPLE:
+			for (MAYA_STL size_t i = 0; i < count; i++) {
+				double x = src[i];
+				MAYA_STL memcpy(bytes + i * 8, &x, 8);
+			}
+			break;
+	}
+}
+
+void InterleaveSamples(float* dst, float const* const* src, unsigned channels, MAYA_STL size_t frames)
+{
+	MAYA_STL size_t i = 0;
+	if (channels == 2)
+	{
+#if MAYA_AUDIO_SSE2
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 l = _mm_loadu_ps(src[0] + i), r = _mm_loadu_ps(src[1] + i);
+			_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+		}
+#elif MAYA_AUDIO_NEON
+		for (; i + 4 <= frames; i += 4)
+			vst2q_f32(dst + i * 2, float32x4x2_t{ { vld1q_f32(src[0] + i), vld1q_f32(src[1] + i) } });
+#endif
+	}
+	for (; i < frames; i++)
+		for (unsigned c = 0; c < channels; c++)
+			dst[i * channels + c] = src[c][i];
+}
+
+void DeinterleaveSamples(float* const* dst, float const* src, unsigned channels, MAYA_STL size_t frames)
+{
+	MAYA_STL size_t i = 0;
+	if (channels == 2)
+	{
+#if MAYA_AUDIO_SSE2
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(src + i * 2), b = _mm_loadu_ps(src + i * 2 + 4);
+			_mm_storeu_ps(dst[0] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(dst[1] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+#elif MAYA_AUDIO_NEON
+		for (; i + 4 <= frames; i += 4)
+		{
+			float32x4x2_t x = vld2q_f32(src + i * 2);
+			vst1q_f32(dst[0] + i, x.val[0]);
+			vst1q_f32(dst[1] + i, x.val[1]);
+		}
+#endif
+	}
+	for (; i < frames; i++)
+		for (unsigned c = 0; c < channels; c++)
+			dst[c][i] = src[i * channels + c];
+}
+
+void RemixChannels(float* dst, unsigned dstchannels, float const* src, unsigned srcchannels, MAYA_STL size_t frames)
+{
+	MAYA_STL size_t i = 0;
+	if (dstchannels == srcchannels)
+	{
+		MAYA_STL memcpy(dst, src, frames * dstchannels * sizeof(float));
+	}
+	else if (srcchannels == 1)
+	{
+		if (dstchannels == 2)
+		{
+#if MAYA_AUDIO_SSE2
+			for (; i + 4 <= frames; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(src + i);
+				_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(x, x));
+				_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(x, x));
+			}
+#elif MAYA_AUDIO_NEON
+			for (; i + 4 <= frames; i += 4) {
+				float32x4_t x = vld1q_f32(src + i);
+				vst2q_f32(dst + i * 2, float32x4x2_t{ { x, x } });
+			}
+#endif
+		}
+		for (; i < frames; i++)
+			MAYA_STL fill_n(dst + i * dstchannels, dstchannels, src[i]);
+	}
+	else if (dstchannels == 1)
+	{
+		if (srcchannels == 2)
+		{
+#if MAYA_AUDIO_SSE2
+			__m128 half = _mm_set1_ps(0.5f);
+			for (; i + 4 <= frames; i += 4)
+			{
+				__m128 a = _mm_loadu_ps(src + i * 2), b = _mm_loadu_ps(src + i * 2 + 4);
+				__m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+				_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+			}
+#elif MAYA_AUDIO_NEON
+			for (; i + 4 <= frames; i += 4) {
+				float32x4x2_t x = vld2q_f32(src + i * 2);
+				vst1q_f32(dst + i, vmulq_n_f32(vaddq_f32(x.val[0], x.val[1]), 0.5f));
+			}
+#endif
+		}
+		float inv = 1.0f / srcchannels;
+		for (; i < frames; i++) {
+			float sum = 0;
+			for (unsigned c = 0; c < srcchannels; c++)
+				sum += src[i * srcchannels + c];
+			dst[i] = sum * inv;
+		}
+	}
+	else if (srcchannels == 6 && dstchannels == 2)
+	{
+		// The low frequency channel is dropped, as in the ITU-R BS.775 downmix.
+		const float k = 0.70710678f;
+		for (; i < frames; i++) {
+			float const* f = src + i * 6;
+			dst[i * 2] = f[0] + k * (f[2] + f[4]);
+			dst[i * 2 + 1] = f[1] + k * (f[2] + f[5]);
+		}
+	}
+	else
+	{
+		unsigned common = MAYA_STL min(dstchannels, srcchannels);
+		for (; i < frames; i++) {
+			MAYA_STL copy_n(src + i * srcchannels, common, dst + i * dstchannels);
+			MAYA_STL fill(dst + i * dstchannels + common, dst + (i + 1) * dstchannels, 0.0f);
+		}
+	}
+}
+
+static int16_t const s_AdpcmSteps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static int const s_AdpcmIndexSteps[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+MAYA_STL size_t GetAdpcmSize(unsigned channels, MAYA_STL size_t frames)
+{
+	return (frames + AdpcmBlockFrames - 1) / AdpcmBlockFrames * channels * AdpcmBlockSize;
+}
+
+void EncodeAdpcm(void* dst, float const* src, unsigned channels, MAYA_STL size_t frames)
+{
+	unsigned char* out = static_cast<unsigned char*>(dst);
+	MAYA_STL size_t blocks = (frames + AdpcmBlockFrames - 1) / AdpcmBlockFrames;
+	for (unsigned c = 0; c < channels; c++)
+	{
+		// The state runs on across blocks, the header only lets decoding start there.
+		int pred = 0, index = 0;
+		for (MAYA_STL size_t b = 0; b < blocks; b++)
+		{
+			unsigned char* block = out + (b * channels + c) * AdpcmBlockSize;
+			int16_t head = static_cast<int16_t>(pred);
+			MAYA_STL memcpy(block, &head, 2);
+			block[2] = static_cast<unsigned char>(index);
+			block[3] = 0;
+			MAYA_STL memset(block + 4, 0, AdpcmBlockSize - 4);
+
+			for (unsigned j = 0; j < AdpcmBlockFrames; j++)
+			{
+				MAYA_STL size_t i = b * AdpcmBlockFrames + j;
+				int target = i < frames ? s_FloatToInt(src[i * channels + c], 16) : 0;
+				int step = s_AdpcmSteps[index], diff = target - pred, code = 0;
+				if (diff < 0) { code = 8; diff = -diff; }
+				int delta = step >> 3;
+				if (diff >= step) { code |= 4; diff -= step; delta += step; }
+				if (diff >= step >> 1) { code |= 2; diff -= step >> 1; delta += step >> 1; }
+				if (diff >= step >> 2) { code |= 1; delta += step >> 2; }
+				pred = MAYA_STL clamp(code & 8 ? pred - delta : pred + delta, -32768, 32767);
+				index = MAYA_STL clamp(index + s_AdpcmIndexSteps[code & 7], 0, 88);
+				block[4 + j / 2] |= static_cast<unsigned char>(code << (j & 1) * 4);
+			}
+		}
+	}
+}
+
+// Decode 8 blocks at once to pcm[sample * 8 + lane].
+// The decoder is a recurrence within a block, so the lanes run across blocks rather than samples.
+static void s_DecodeAdpcmBlocks(unsigned char const* const* blocks, int16_t* pcm)
+{
+#if MAYA_AUDIO_SSE2
+	alignas(16) int16_t codes[AdpcmBlockFrames / 2 * 8], head[8], steps[8];
+	for (unsigned l = 0; l < 8; l++) {
+		MAYA_STL memcpy(head + l, blocks[l], 2);
+		steps[l] = static_cast<int16_t>(MAYA_STL min<int>(blocks[l][2], 88));
+		for (unsigned j = 0; j < AdpcmBlockFrames / 2; j++)
+			codes[j * 8 + l] = blocks[l][4 + j];
+	}
+	__m128i pred = _mm_load_si128(reinterpret_cast<__m128i const*>(head));
+	__m128i index = _mm_load_si128(reinterpret_cast<__m128i const*>(steps));
+	__m128i one = _mm_set1_epi16(1), two = _mm_set1_epi16(2), four = _mm_set1_epi16(4), eight = _mm_set1_epi16(8);
+	__m128i low = _mm_set1_epi16(15), three = _mm_set1_epi16(3), top = _mm_set1_epi16(88);
+	for (unsigned j = 0; j < AdpcmBlockFrames; j++)
+	{
+		__m128i code = _mm_load_si128(reinterpret_cast<__m128i const*>(codes + j / 2 * 8));
+		code = _mm_and_si128(j & 1 ? _mm_srli_epi16(code, 4) : code, low);
+		_mm_store_si128(reinterpret_cast<__m128i*>(steps), index);
+		__m128i step = _mm_setr_epi16(s_AdpcmSteps[steps[0]], s_AdpcmSteps[steps[1]], s_AdpcmSteps[steps[2]], s_AdpcmSteps[steps[3]],
+			s_AdpcmSteps[steps[4]], s_AdpcmSteps[steps[5]], s_AdpcmSteps[steps[6]], s_AdpcmSteps[steps[7]]);
+
+		// The delta reaches 1.875 steps, beyond int16, so it is added in two halves with saturation.
+		// Both halves share a sign, so saturating twice equals clamping once.
+		__m128i bit4 = _mm_cmpeq_epi16(_mm_and_si128(code, four), four);
+		__m128i delta = _mm_srli_epi16(step, 3);
+		delta = _mm_add_epi16(delta, _mm_and_si128(step, bit4));
+		delta = _mm_add_epi16(delta, _mm_and_si128(_mm_srli_epi16(step, 1), _mm_cmpeq_epi16(_mm_and_si128(code, two), two)));
+		delta = _mm_add_epi16(delta, _mm_and_si128(_mm_srli_epi16(step, 2), _mm_cmpeq_epi16(_mm_and_si128(code, one), one)));
+		__m128i half = _mm_srli_epi16(delta, 1), rest = _mm_sub_epi16(delta, half);
+		__m128i neg = _mm_cmpeq_epi16(_mm_and_si128(code, eight), eight);
+		__m128i up = _mm_adds_epi16(_mm_adds_epi16(pred, half), rest);
+		__m128i down = _mm_subs_epi16(_mm_subs_epi16(pred, half), rest);
+		pred = _mm_or_si128(_mm_and_si128(neg, down), _mm_andnot_si128(neg, up));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pcm + j * 8), pred);
+
+		// Index moves by -1, or by 2, 4, 6, 8 when the magnitude bit 4 is set.
+		__m128i grow = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(code, three), 1), two);
+		__m128i move = _mm_or_si128(_mm_and_si128(bit4, grow), _mm_andnot_si128(bit4, _mm_set1_epi16(-1)));
+		index = _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(index, move), _mm_setzero_si128()), top);
+	}
+#else
+	for (unsigned l = 0; l < 8; l++)
+	{
+		int16_t head;
+		MAYA_STL memcpy(&head, blocks[l], 2);
+		int pred = head, index = MAYA_STL min<int>(blocks[l][2], 88);
+		for (unsigned j = 0; j < AdpcmBlockFrames; j++)
+		{
+			int code = (blocks[l][4 + j / 2] >> (j & 1) * 4) & 15, step = s_AdpcmSteps[index];
+			int delta = step >> 3;
+			if (code & 4) delta += step;
+			if (code & 2) delta += step >> 1;
+			if (code & 1) delta += step >> 2;
+			pred = MAYA_STL clamp(code & 8 ? pred - delta : pred + delta, -32768, 32767);
+			index = MAYA_STL clamp(index + s_AdpcmIndexSteps[code & 7], 0, 88);
+			pcm[j * 8 + l] = static_cast<int16_t>(pred);
+		}
+	}
+#endif
+}
+
+void DecodeAdpcm(float* dst, void const* src, unsigned channels, MAYA_STL size_t first, MAYA_STL size_t count)
+{
+	if (!count || !channels)
+		return;
+	unsigned char const* data = static_cast<unsigned char const*>(src);
+	MAYA_STL size_t begin = first / AdpcmBlockFrames * channels;
+	MAYA_STL size_t end = ((first + count - 1) / AdpcmBlockFrames + 1) * channels;
+
+	// Blocks are numbered across frames and channels, and decoded eight at a time.
+	alignas(16) int16_t pcm[AdpcmBlockFrames * 8];
+	for (MAYA_STL size_t k = begin; k < end; k += 8)
+	{
+		unsigned lanes = static_cast<unsigned>(MAYA_STL min<MAYA_STL size_t>(8, end - k));
+		unsigned char const* blocks[8];
+		for (unsigned l = 0; l < 8; l++)
+			blocks[l] = data + (k + MAYA_STL min(l, lanes - 1)) * AdpcmBlockSize;
+		s_DecodeAdpcmBlocks(blocks, pcm);
+
+		for (unsigned l = 0; l < lanes; l++)
+		{
+			MAYA_STL size_t start = (k + l) / channels * AdpcmBlockFrames;
+			unsigned c = static_cast<unsigned>((k + l) % channels);
+			MAYA_STL size_t lo = MAYA_STL max(start, first), hi = MAYA_STL min(start + AdpcmBlockFrames, first + count);
+			for (MAYA_STL size_t i = lo; i < hi; i++)
+				dst[(i - first) * channels + c] = pcm[(i - start) * 8 + l] * (1.0f / 32768.0f);
+		}
+	}
+}
+
+}
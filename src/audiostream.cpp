@@ -0,0 +1,465 @@
+#include <maya/audiostream.hpp>
+#include <minimp3/minimp3.h>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+namespace maya
+{
+
+SampleRing::SampleRing(MAYA_STL size_t capacity)
+	: write(0), read(0)
+{
+	MAYA_STL size_t size = 1;
+	while (size < capacity) size <<= 1;
+	buffer.resize(size);
+	mask = size - 1;
+}
+
+MAYA_STL size_t SampleRing::Write(float const* samples, MAYA_STL size_t count)
+{
+	MAYA_STL uint64_t w = write.load(MAYA_STL memory_order_relaxed);
+	MAYA_STL uint64_t r = read.load(MAYA_STL memory_order_acquire);
+	count = MAYA_STL min(count, buffer.size() - static_cast<MAYA_STL size_t>(w - r));
+	MAYA_STL size_t at = static_cast<MAYA_STL size_t>(w) & mask;
+	MAYA_STL size_t first = MAYA_STL min(count, buffer.size() - at);
+	MAYA_STL memcpy(buffer.data() + at, samples, first * sizeof(float));
+	MAYA_STL memcpy(buffer.data(), samples + first, (count - first) * sizeof(float));
+	write.store(w + count, MAYA_STL memory_order_release);
+	return count;
+}
+
+MAYA_STL size_t SampleRing::Read(float* samples, MAYA_STL size_t count)
+{
+	MAYA_STL uint64_t r = read.load(MAYA_STL memory_order_relaxed);
+	MAYA_STL uint64_t w = write.load(MAYA_STL memory_order_acquire);
+	count = MAYA_STL min(count, static_cast<MAYA_STL size_t>(w - r));
+	MAYA_STL size_t at = static_cast<MAYA_STL size_t>(r) & mask;
+	MAYA_STL size_t first = MAYA_STL min(count, buffer.size() - at);
+	MAYA_STL memcpy(samples, buffer.data() + at, first * sizeof(float));
+	MAYA_STL memcpy(samples + first, buffer.data(), (count - first) * sizeof(float));
+	read.store(r + count, MAYA_STL memory_order_release);
+	return count;
+}
+
+void SampleRing::SkipTo(MAYA_STL uint64_t position)
+{
+	read.store(position, MAYA_STL memory_order_release);
+}
+
+AudioCommandQueue::AudioCommandQueue(MAYA_STL size_t capacity)
+	: write(0), read(0)
+{
+	MAYA_STL size_t size = 1;
+	while (size < capacity) size <<= 1;
+	buffer.resize(size);
+	mask = size - 1;
+}
+
+bool AudioCommandQueue::Push(AudioCommand const& command)
+{
+	MAYA_STL uint64_t w = write.load(MAYA_STL memory_order_relaxed);
+	if (w - read.load(MAYA_STL memory_order_acquire) >= buffer.size())
+		return false;
+	buffer[static_cast<MAYA_STL size_t>(w) & mask] = command;
+	write.store(w + 1, MAYA_STL memory_order_release);
+	return true;
+}
+
+AudioCommand const* AudioCommandQueue::Peek() const
+{
+	MAYA_STL uint64_t r = read.load(MAYA_STL memory_order_relaxed);
+	if (r == write.load(MAYA_STL memory_order_acquire))
+		return 0;
+	return &buffer[static_cast<MAYA_STL size_t>(r) & mask];
+}
+
+void AudioCommandQueue::Pop()
+{
+	read.store(read.load(MAYA_STL memory_order_relaxed) + 1, MAYA_STL memory_order_release);
+}
+
+// Frames decoded before a seek target, so that the bit reservoir is filled again.
+static constexpr int s_Mp3Preroll = 8;
+
+// Samples per channel of a frame by its header, which the decoder reports as 0 while the bit reservoir is still filling.
+static int s_Mp3FrameSamples(mp3dec_frame_info_t const& info)
+{
+	if (info.layer == 1) return 384;
+	if (info.layer == 2 || info.hz >= 32000) return 1152;
+	return 576;
+}
+
+// Count the frames of the whole file by parsing headers only.
+static MAYA_STL uint64_t s_CountMp3Frames(unsigned char const* data, MAYA_STL size_t size)
+{
+	mp3dec_t dec;
+	mp3dec_init(&dec);
+	mp3dec_frame_info_t info;
+	MAYA_STL uint64_t frames = 0;
+	for (MAYA_STL size_t offset = 0; offset < size; offset += info.frame_bytes) {
+		frames += mp3dec_decode_frame(&dec, data + offset, static_cast<int>(size - offset), nullptr, &info);
+		if (!info.frame_bytes) break;
+	}
+	return frames;
+}
+
+Mp3Stream::Mp3Stream(char const* path, float buffertime)
+	: running(false), eof(false), framecount(0), position(0),
+	seekrequest(0), seekserved(0), seekframe(0), seekmark(0), seekmarkframe(0), seekapplied(0)
+{
+	if (!file.Open(path)) return;
+
+	// Parse headers until the first audio frame to know the format.
+	mp3dec_t dec;
+	mp3dec_init(&dec);
+	mp3dec_frame_info_t info;
+	for (MAYA_STL size_t offset = 0; offset < file.GetSize(); offset += info.frame_bytes) {
+		int samples = mp3dec_decode_frame(&dec, file.GetData() + offset, static_cast<int>(file.GetSize() - offset), nullptr, &info);
+		if (!info.frame_bytes) break;
+		if (samples) {
+			samplerate = info.hz;
+			channels = info.channels;
+			break;
+		}
+	}
+
+	if (!channels) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_FORMAT_ERROR, "No mp3 frame is found in \"" + stl::string(path) + "\"");
+		file.Close();
+		return;
+	}
+
+	auto capacity = static_cast<MAYA_STL size_t>(buffertime * samplerate) * channels;
+	ring = MAYA_STL make_unique<SampleRing>(MAYA_STL max<MAYA_STL size_t>(capacity, MINIMP3_MAX_SAMPLES_PER_FRAME));
+	running = true;
+	thread = MAYA_STL thread(&Mp3Stream::Decode, this);
+}
+
+Mp3Stream::~Mp3Stream()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+void Mp3Stream::Decode()
+{
+	unsigned char const* data = file.GetData();
+	MAYA_STL size_t size = file.GetSize();
+	mp3dec_t dec;
+	mp3dec_init(&dec);
+	mp3dec_frame_info_t info;
+
+	stl::list<int16_t> pcm(MINIMP3_MAX_SAMPLES_PER_FRAME);
+	stl::list<float> samples(MINIMP3_MAX_SAMPLES_PER_FRAME);
+	MAYA_STL size_t offset = 0, pending = 0, written = 0;
+	MAYA_STL uint64_t skip = 0;
+	unsigned served = 0;
+	bool counted = false;
+
+	while (running)
+	{
+		unsigned request = seekrequest.load(MAYA_STL memory_order_acquire);
+		if (request != served)
+		{
+			// Find the frame containing the target by headers, keeping the offsets of a few frames before.
+			MAYA_STL uint64_t target = seekframe.load(MAYA_STL memory_order_relaxed), start = 0;
+			MAYA_STL size_t history[s_Mp3Preroll + 1];
+			MAYA_STL uint64_t starts[s_Mp3Preroll + 1];
+			int count = 0;
+			mp3dec_t scan;
+			mp3dec_init(&scan);
+			for (offset = 0; offset < size; offset += info.frame_bytes) {
+				int frame = mp3dec_decode_frame(&scan, data + offset, static_cast<int>(size - offset), nullptr, &info);
+				if (!info.frame_bytes) {
+					offset = size;
+					break;
+				}
+				if (!frame) continue;
+				history[count % (s_Mp3Preroll + 1)] = offset;
+				starts[count % (s_Mp3Preroll + 1)] = start;
+				count++;
+				if (start + frame > target) break;
+				start += frame;
+			}
+			if (offset < size) {
+				int first = MAYA_STL max(0, count - 1 - s_Mp3Preroll) % (s_Mp3Preroll + 1);
+				offset = history[first];
+				skip = (target - starts[first]) * channels;
+			}
+			else target = start;
+
+			mp3dec_init(&dec);
+			pending = written = 0;
+			eof = false;
+			seekmark.store(ring->GetWritePosition(), MAYA_STL memory_order_relaxed);
+			seekmarkframe.store(target, MAYA_STL memory_order_relaxed);
+			seekserved.store(request, MAYA_STL memory_order_release);
+			served = request;
+			continue;
+		}
+
+		if (written == pending)
+		{
+			if (offset >= size) {
+				if (!counted) {
+					framecount = s_CountMp3Frames(data, size);
+					counted = true;
+				}
+				eof = true;
+				MAYA_STL this_thread::sleep_for(MAYA_STL chrono::milliseconds(5));
+				continue;
+			}
+			// Skipped junk leaves the channels unset, so it is not taken for a frame.
+			info.channels = 0;
+			int frame = mp3dec_decode_frame(&dec, data + offset, static_cast<int>(size - offset), pcm.data(), &info);
+			if (!info.frame_bytes) {
+				offset = size;
+				continue;
+			}
+			offset += info.frame_bytes;
+			if (static_cast<unsigned>(info.channels) != channels) continue;
+
+			// A frame that cannot be decoded yet still spans its samples, as counted by the seek,
+			// so it is played as silence to keep the position in step.
+			if (!frame) {
+				pending = static_cast<MAYA_STL size_t>(s_Mp3FrameSamples(info)) * channels;
+				MAYA_STL fill(samples.begin(), samples.begin() + pending, 0.0f);
+			}
+			else {
+				pending = static_cast<MAYA_STL size_t>(frame) * channels;
+				ConvertToFloat(samples.data(), pcm.data(), S16_SAMPLE, pending);
+			}
+			written = static_cast<MAYA_STL size_t>(MAYA_STL min<MAYA_STL uint64_t>(skip, pending));
+			skip -= written;
+			continue;
+		}
+
+		written += ring->Write(samples.data() + written, pending - written);
+		if (written == pending) continue;
+
+		// The ring is full, spend the idle time counting the frames.
+		if (!counted) {
+			framecount = s_CountMp3Frames(data, size);
+			counted = true;
+		}
+		else MAYA_STL this_thread::sleep_for(MAYA_STL chrono::milliseconds(5));
+	}
+}
+
+unsigned Mp3Stream::Read(float* out, unsigned frames)
+{
+	if (!ring)
+		return 0;
+	unsigned served = seekserved.load(MAYA_STL memory_order_acquire);
+	if (served != seekapplied.load(MAYA_STL memory_order_relaxed)) {
+		ring->SkipTo(seekmark.load(MAYA_STL memory_order_relaxed));
+		position.store(seekmarkframe.load(MAYA_STL memory_order_relaxed), MAYA_STL memory_order_relaxed);
+		seekapplied.store(served, MAYA_STL memory_order_relaxed);
+	}
+	// Wait for the decoder to serve the latest seek, rather than play what is before it.
+	if (seekrequest.load(MAYA_STL memory_order_relaxed) != served) return 0;
+
+	MAYA_STL size_t count = MAYA_STL min<MAYA_STL size_t>(ring->GetReadable() / channels, frames) * channels;
+	ring->Read(out, count);
+	position.store(position.load(MAYA_STL memory_order_relaxed) + count / channels, MAYA_STL memory_order_relaxed);
+	return static_cast<unsigned>(count / channels);
+}
+
+void Mp3Stream::Seek(MAYA_STL uint64_t frame)
+{
+	seekframe.store(frame, MAYA_STL memory_order_relaxed);
+	seekrequest.fetch_add(1, MAYA_STL memory_order_release);
+}
+
+MAYA_STL uint64_t Mp3Stream::GetPosition() const
+{
+	return position.load(MAYA_STL memory_order_relaxed);
+}
+
+MAYA_STL uint64_t Mp3Stream::GetFrameCount() const
+{
+	return framecount.load(MAYA_STL memory_order_relaxed);
+}
+
+bool Mp3Stream::IsEndReached() const
+{
+	if (!ring)
+		return true;
+	unsigned request = seekrequest.load(MAYA_STL memory_order_acquire);
+	return eof && request == seekserved.load(MAYA_STL memory_order_acquire)
+		&& request == seekapplied.load(MAYA_STL memory_order_relaxed) && !ring->GetReadable();
+}
+
+// Bytes read ahead of the playing position, so that the callback rarely waits on a page fault.
+static constexpr MAYA_STL size_t s_WavReadahead = 1 << 18;
+
+static inline unsigned s_Le16(unsigned char const* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t s_Le32(unsigned char const* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool WavFormat::Parse(ConstBuffer<void> file, stl::string& reason)
+{
+	auto* data = static_cast<unsigned char const*>(file.Data);
+	if (file.Size < 12 || MAYA_STL memcmp(data, "RIFF", 4) || MAYA_STL memcmp(data + 8, "WAVE", 4)) {
+		reason = "not a RIFF WAVE file";
+		return false;
+	}
+
+	bool hasformat = false;
+	DataOffset = DataSize = 0;
+	for (MAYA_STL size_t pos = 12; pos + 8 <= file.Size; )
+	{
+		MAYA_STL size_t size = s_Le32(data + pos + 4), body = pos + 8;
+		MAYA_STL size_t available = MAYA_STL min(size, file.Size - body);
+
+		if (!MAYA_STL memcmp(data + pos, "fmt ", 4)) {
+			if (available < 16) {
+				reason = "truncated fmt chunk";
+				return false;
+			}
+			Encoding = s_Le16(data + body);
+			Channels = s_Le16(data + body + 2);
+			SampleRate = s_Le32(data + body + 4);
+			BlockAlign = s_Le16(data + body + 12);
+			BitsPerSample = s_Le16(data + body + 14);
+			// WAVE_FORMAT_EXTENSIBLE keeps the actual encoding at the start of the sub format GUID.
+			if (Encoding == 0xFFFE && available >= 26)
+				Encoding = s_Le16(data + body + 24);
+			hasformat = true;
+		}
+		else if (!MAYA_STL memcmp(data + pos, "data", 4)) {
+			// The size is a placeholder in files still being written, so it is clamped to the file.
+			DataOffset = body;
+			DataSize = available;
+			if (hasformat) break;
+		}
+
+		if (size > file.Size - body) break;
+		pos = body + size + (size & 1); // chunks are padded to even sizes.
+	}
+
+	if (!hasformat) reason = "no fmt chunk";
+	else if (!DataOffset) reason = "no data chunk";
+	else if (!Channels || BlockAlign != Channels * BitsPerSample / 8) reason = "inconsistent block alignment";
+	else if (Encoding == 1 && BitsPerSample != 8 && BitsPerSample != 16 && BitsPerSample != 24 && BitsPerSample != 32)
+		reason = "Pulse Code Modulation with " + MAYA_STL to_string(BitsPerSample) + " bits per sample is not supported";
+	else if (Encoding == 3 && BitsPerSample != 32 && BitsPerSample != 64)
+		reason = "IEEE 754 with " + MAYA_STL to_string(BitsPerSample) + " bits per sample is not supported";
+	else if (Encoding != 1 && Encoding != 3) reason = "unknown format (" + MAYA_STL to_string(Encoding) + ")";
+	else {
+		DataSize -= DataSize % BlockAlign;
+		return true;
+	}
+	return false;
+}
+
+WavStream::WavStream(char const* path)
+	: framecount(0), position(0), seekframe(0), looping(false), seeking(false), running(false), wanted(0)
+{
+	if (!file.Open(path)) return;
+	stl::string reason;
+	if (!format.Parse({ file.GetData(), file.GetSize() }, reason)) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_FORMAT_ERROR, "Unable to stream \"" + stl::string(path) + "\": " + reason);
+		file.Close();
+		return;
+	}
+	samplerate = format.SampleRate;
+	channels = format.Channels;
+	framecount = format.DataSize / format.BlockAlign;
+	running = true;
+	thread = MAYA_STL thread(&WavStream::Prefetch, this);
+}
+
+WavStream::~WavStream()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+void WavStream::Prefetch()
+{
+	// Prefetching may wait on the disk, so it is kept off the audio thread, which only publishes its position.
+	MAYA_STL size_t prefetched = 0;
+	bool first = true;
+	while (running)
+	{
+		MAYA_STL size_t byte = wanted.load(MAYA_STL memory_order_relaxed);
+		if (first || byte + s_WavReadahead / 2 >= prefetched || byte + s_WavReadahead < prefetched - s_WavReadahead) {
+			file.Prefetch(format.DataOffset + byte, s_WavReadahead);
+			prefetched = byte + s_WavReadahead;
+			first = false;
+		}
+		MAYA_STL this_thread::sleep_for(MAYA_STL chrono::milliseconds(5));
+	}
+}
+
+SampleFormat WavFormat::GetSampleFormat() const
+{
+	if (Encoding == 3)
+		return BitsPerSample == 64 ? F64_SAMPLE : F32_SAMPLE;
+	switch (BitsPerSample)
+	{
+		case 8: return U8_SAMPLE;
+		case 16: return S16_SAMPLE;
+		case 24: return S24_SAMPLE;
+		default: return S32_SAMPLE;
+	}
+}
+
+unsigned WavStream::Read(float* out, unsigned frames)
+{
+	if (seeking.exchange(false, MAYA_STL memory_order_acquire))
+		position.store(MAYA_STL min(seekframe.load(MAYA_STL memory_order_relaxed), framecount), MAYA_STL memory_order_relaxed);
+
+	MAYA_STL uint64_t pos = position.load(MAYA_STL memory_order_relaxed);
+	unsigned done = 0;
+	while (done < frames)
+	{
+		if (pos >= framecount) {
+			if (!looping || !framecount) break;
+			pos = 0;
+		}
+		auto count = static_cast<unsigned>(MAYA_STL min<MAYA_STL uint64_t>(frames - done, framecount - pos));
+		ConvertToFloat(out + done * channels, file.GetData() + format.DataOffset + pos * format.BlockAlign, format.GetSampleFormat(), count * channels);
+		pos += count;
+		done += count;
+	}
+	position.store(pos, MAYA_STL memory_order_relaxed);
+	wanted.store(static_cast<MAYA_STL size_t>(pos) * format.BlockAlign, MAYA_STL memory_order_relaxed);
+	return done;
+}
+
+void WavStream::Seek(MAYA_STL uint64_t frame)
+{
+	seekframe.store(frame, MAYA_STL memory_order_relaxed);
+	seeking.store(true, MAYA_STL memory_order_release);
+	wanted.store(static_cast<MAYA_STL size_t>(MAYA_STL min(frame, framecount)) * format.BlockAlign, MAYA_STL memory_order_relaxed);
+}
+
+MAYA_STL uint64_t WavStream::GetPosition() const
+{
+	return seeking.load(MAYA_STL memory_order_acquire) ? seekframe.load(MAYA_STL memory_order_relaxed) : position.load(MAYA_STL memory_order_relaxed);
+}
+
+MAYA_STL uint64_t WavStream::GetFrameCount() const
+{
+	return framecount;
+}
+
+bool WavStream::IsEndReached() const
+{
+	return !looping && !seeking.load(MAYA_STL memory_order_acquire) && position.load(MAYA_STL memory_order_relaxed) >= framecount;
+}
+
+}
@@ -0,0 +1,288 @@
+#include <maya/dataio.hpp>
+#include <maya/async.hpp>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYA_BLOCK_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYA_BLOCK_SSE2 0
+#endif
+
+namespace maya
+{
+
+// 4x4 pixels of RGBA.
+using s_Block = unsigned char[16][4];
+
+// Fetch a block with edges clamped, gray images are expanded to RGB if expand is set.
+static void s_FetchBlock(ImageData const& image, int bx, int by, bool expand, s_Block& block)
+{
+	int const ch = image.Channels;
+	for (int j = 0; j < 4; j++) {
+		int y = MAYA_STL min(by * 4 + j, image.Size.y - 1);
+		for (int i = 0; i < 4; i++) {
+			int x = MAYA_STL min(bx * 4 + i, image.Size.x - 1);
+			unsigned char const* p = &image.Data[(static_cast<MAYA_STL size_t>(y) * image.Size.x + x) * ch];
+			unsigned char* q = block[j * 4 + i];
+			if (expand && ch <= 2) {
+				q[0] = q[1] = q[2] = p[0];
+				q[3] = ch == 2 ? p[1] : 255;
+			}
+			else {
+				for (int k = 0; k < 4; k++)
+					q[k] = k < ch ? p[k] : (k == 3 ? 255 : 0);
+			}
+		}
+	}
+}
+
+// Per channel minimum and maximum of a block.
+static void s_BlockBounds(s_Block const& block, unsigned char (&lo)[4], unsigned char (&hi)[4])
+{
+#if MAYA_BLOCK_SSE2
+	auto* p = reinterpret_cast<__m128i const*>(block);
+	__m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1);
+	__m128i c = _mm_loadu_si128(p + 2), d = _mm_loadu_si128(p + 3);
+	__m128i mn = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+	__m128i mx = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+	mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+	mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+	int l = _mm_cvtsi128_si32(mn), h = _mm_cvtsi128_si32(mx);
+	MAYA_STL memcpy(lo, &l, 4);
+	MAYA_STL memcpy(hi, &h, 4);
+#else
+	for (int k = 0; k < 4; k++) {
+		lo[k] = hi[k] = block[0][k];
+		for (int i = 1; i < 16; i++) {
+			lo[k] = MAYA_STL min(lo[k], block[i][k]);
+			hi[k] = MAYA_STL max(hi[k], block[i][k]);
+		}
+	}
+#endif
+}
+
+static MAYA_STL uint16_t s_Pack565(int r, int g, int b)
+{
+	return static_cast<MAYA_STL uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static void s_Unpack565(MAYA_STL uint16_t c, int (&rgb)[3])
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Color endpoints from the inset bounding box, indices by nearest palette entry.
+static void s_EncodeColorBlock(s_Block const& block, unsigned char* out)
+{
+	unsigned char lo[4], hi[4];
+	s_BlockBounds(block, lo, hi);
+
+	int mn[3], mx[3];
+	for (int k = 0; k < 3; k++) {
+		int inset = (hi[k] - lo[k]) >> 4;
+		mn[k] = lo[k] + inset;
+		mx[k] = hi[k] - inset;
+	}
+
+	// Pick the diagonal of the box along the channel with the largest range.
+	int axis = 0;
+	for (int k = 1; k < 3; k++)
+		if (mx[k] - mn[k] > mx[axis] - mn[axis]) axis = k;
+
+	int mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int k = 0; k < 3; k++) mean[k] += block[i][k];
+
+	for (int k = 0; k < 3; k++)
+	{
+		if (k == axis) continue;
+		int cov = 0;
+		for (int i = 0; i < 16; i++)
+			cov += (block[i][axis] * 16 - mean[axis]) * (block[i][k] * 16 - mean[k]) / 256;
+		if (cov < 0) MAYA_STL swap(mn[k], mx[k]);
+	}
+
+	MAYA_STL uint16_t c0 = s_Pack565(mx[0], mx[1], mx[2]);
+	MAYA_STL uint16_t c1 = s_Pack565(mn[0], mn[1], mn[2]);
+	MAYA_STL uint32_t indices = 0;
+
+	if (c0 != c1)
+	{
+		if (c0 < c1) MAYA_STL swap(c0, c1); // c0 > c1 selects the four color mode.
+
+		int palette[4][3];
+		s_Unpack565(c0, palette[0]);
+		s_Unpack565(c1, palette[1]);
+		for (int k = 0; k < 3; k++) {
+			palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+			palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+		}
+
+#if MAYA_BLOCK_SSE2
+		// Four pixels at a time, the first nearest entry wins ties as in the scalar loop.
+		__m128i pal[4];
+		for (int p = 0; p < 4; p++)
+			pal[p] = _mm_setr_epi16(palette[p][0], palette[p][1], palette[p][2], 0, palette[p][0], palette[p][1], palette[p][2], 0);
+		__m128i rgb = _mm_set1_epi32(0x00FFFFFF), zero = _mm_setzero_si128();
+		for (int g = 0; g < 4; g++) {
+			__m128i px = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(block[g * 4])), rgb);
+			__m128i lo = _mm_unpacklo_epi8(px, zero), hi = _mm_unpacklo_epi8(_mm_srli_si128(px, 8), zero);
+			__m128i best = zero, bestdist = _mm_set1_epi32(1 << 30);
+			for (int p = 0; p < 4; p++) {
+				// Squares of red and green, and of blue, per pixel, then summed across the pairs.
+				__m128i a = _mm_sub_epi16(lo, pal[p]), b = _mm_sub_epi16(hi, pal[p]);
+				a = _mm_madd_epi16(a, a);
+				b = _mm_madd_epi16(b, b);
+				__m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+				__m128i dist = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+					_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+				__m128i closer = _mm_cmplt_epi32(dist, bestdist);
+				bestdist = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, bestdist));
+				best = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, best));
+			}
+			alignas(16) int lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), best);
+			for (int i = 0; i < 4; i++)
+				indices |= static_cast<MAYA_STL uint32_t>(lanes[i]) << (2 * (g * 4 + i));
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestdist = 1 << 30;
+			for (int p = 0; p < 4; p++) {
+				int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestdist) { bestdist = dist; best = p; }
+			}
+			indices |= static_cast<MAYA_STL uint32_t>(best) << (2 * i);
+		}
+#endif
+	}
+
+	out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// Single channel block with eight interpolated values.
+static void s_EncodeChannelBlock(s_Block const& block, int channel, unsigned char* out)
+{
+	unsigned char lo[4], hi[4];
+	s_BlockBounds(block, lo, hi);
+	int a0 = hi[channel], a1 = lo[channel];
+
+	MAYA_STL uint64_t indices = 0;
+	if (a0 != a1)
+	{
+		// Position between a1 and a0 in sevenths, mapped to the palette order.
+		int range = a0 - a1;
+#if MAYA_BLOCK_SSE2
+		// The numerator stays below 2^11, so the float quotient truncates to the integer one.
+		__m128i shift = _mm_cvtsi32_si128(8 * channel), mask = _mm_set1_epi32(0xFF), zero = _mm_setzero_si128();
+		__m128i base = _mm_set1_epi32(a1), half = _mm_set1_epi32(range / 2), seven = _mm_set1_epi32(7);
+		__m128 divisor = _mm_set1_ps(static_cast<float>(range));
+		for (int g = 0; g < 4; g++) {
+			__m128i v = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(block[g * 4])), shift), mask);
+			__m128i n = _mm_sub_epi32(v, base);
+			n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(n, 3), n), half);
+			__m128i pos = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(n), divisor));
+			__m128i first = _mm_cmpeq_epi32(pos, zero), last = _mm_cmpeq_epi32(pos, seven);
+			__m128i index = _mm_andnot_si128(_mm_or_si128(first, last), _mm_sub_epi32(_mm_set1_epi32(8), pos));
+			index = _mm_or_si128(index, _mm_and_si128(first, _mm_set1_epi32(1)));
+			alignas(16) int lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+			for (int i = 0; i < 4; i++)
+				indices |= static_cast<MAYA_STL uint64_t>(lanes[i]) << (3 * (g * 4 + i));
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			int pos = ((block[i][channel] - a1) * 7 + range / 2) / range;
+			int index = pos == 0 ? 1 : pos == 7 ? 0 : 8 - pos;
+			indices |= static_cast<MAYA_STL uint64_t>(index) << (3 * i);
+		}
+#endif
+	}
+
+	out[0] = static_cast<unsigned char>(a0);
+	out[1] = static_cast<unsigned char>(a1);
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+static int s_BlockBytes(CompressedFormat format)
+{
+	return format == BC1_FORMAT || format == BC4_FORMAT ? 8 : 16;
+}
+
+static void s_EncodeLevel(ImageData const& image, CompressedFormat format, unsigned threads, stl::list<unsigned char>& out)
+{
+	int bw = MAYA_STL max((image.Size.x + 3) / 4, 1), bh = MAYA_STL max((image.Size.y + 3) / 4, 1);
+	int bytes = s_BlockBytes(format);
+	out.resize(static_cast<MAYA_STL size_t>(bw) * bh * bytes);
+
+	ParallelFor(bh, threads, [&](int begin, int end) {
+		s_Block block;
+		for (int by = begin; by < end; by++) {
+			for (int bx = 0; bx < bw; bx++) {
+				unsigned char* dst = &out[(static_cast<MAYA_STL size_t>(by) * bw + bx) * bytes];
+				switch (format) {
+					case BC1_FORMAT:
+						s_FetchBlock(image, bx, by, true, block);
+						s_EncodeColorBlock(block, dst);
+						break;
+					case BC3_FORMAT:
+						s_FetchBlock(image, bx, by, true, block);
+						s_EncodeChannelBlock(block, 3, dst);
+						s_EncodeColorBlock(block, dst + 8);
+						break;
+					case BC4_FORMAT:
+						s_FetchBlock(image, bx, by, false, block);
+						s_EncodeChannelBlock(block, 0, dst);
+						break;
+					case BC5_FORMAT:
+						s_FetchBlock(image, bx, by, false, block);
+						s_EncodeChannelBlock(block, 0, dst);
+						s_EncodeChannelBlock(block, 1, dst + 8);
+						break;
+				}
+			}
+		}
+	}, 4);
+}
+
+void CompressedImageData::Encode(ImageData const& image, CompressedFormat format, unsigned threads)
+{
+	Levels.clear();
+	Size = image.Size;
+	Format = format;
+
+	if (image.Data.size() < static_cast<MAYA_STL size_t>(image.Size.x) * image.Size.y * image.Channels) [[unlikely]] {
+		MAYA_MAKE_ERROR(OUT_OF_BOUNDS_ERROR, "Image data is smaller than its size and channels.");
+		return;
+	}
+
+	Levels.resize(1);
+	s_EncodeLevel(image, format, threads, Levels[0]);
+}
+
+void CompressedImageData::Encode(MipmapData const& mipmaps, CompressedFormat format, unsigned threads)
+{
+	Levels.clear();
+	Format = format;
+	if (mipmaps.Levels.empty())
+		return;
+
+	Size = mipmaps.Levels[0].Size;
+	Levels.resize(mipmaps.Levels.size());
+	for (MAYA_STL size_t i = 0; i < Levels.size(); i++)
+		s_EncodeLevel(mipmaps.Levels[i], format, threads, Levels[i]);
+}
+
+}
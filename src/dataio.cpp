@@ -1,5 +1,10 @@
 #include <maya/dataio.hpp>
 #include <maya/texture.hpp>
+#include <maya/archive.hpp>
+#include <maya/fileio.hpp>
+#include <maya/audiostream.hpp>
+#include <maya/audioconvert.hpp>
+#include <maya/resampler.hpp>
 #include <stb/stb_image.h>
 #include <filesystem>
 #include <ft2build.h>
@@ -10,6 +15,20 @@
 #include <minimp3/minimp3.h>
 #include <algorithm>
 #include <iterator>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#if MAYA_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #ifdef _MSC_VER
 #pragma warning (disable: 4244)
@@ -18,6 +37,85 @@
 namespace maya
 {
 
+// Parameters of an import in the asset cache key.
+static inline uint64_t s_CacheParams(char kind, int value)
+{
+	return (static_cast<uint64_t>(kind) << 56) | static_cast<uint32_t>(value);
+}
+
+ImageBuffer::~ImageBuffer()
+{
+	clear();
+}
+
+ImageBuffer::ImageBuffer(ImageBuffer const& other)
+{
+	*this = other;
+}
+
+ImageBuffer& ImageBuffer::operator=(ImageBuffer const& other)
+{
+	if (this == &other)
+		return *this;
+	clear();
+	owned.assign(other.begin(), other.end());
+	ptr = owned.data();
+	count = owned.size();
+	return *this;
+}
+
+ImageBuffer::ImageBuffer(ImageBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+ImageBuffer& ImageBuffer::operator=(ImageBuffer&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+	clear();
+	owned = std::move(other.owned); // the pointer stays valid after moving a vector.
+	deleter = std::move(other.deleter);
+	ptr = other.ptr;
+	count = other.count;
+	other.ptr = 0;
+	other.count = 0;
+	other.deleter = nullptr;
+	return *this;
+}
+
+void ImageBuffer::Adopt(unsigned char* data, size_t size, stl::fnptr<void(unsigned char*)> deleter)
+{
+	clear();
+	ptr = data;
+	count = size;
+	this->deleter = std::move(deleter);
+}
+
+void ImageBuffer::resize(size_t size)
+{
+	if (deleter) {
+		owned.assign(ptr, ptr + std::min(size, count));
+		deleter(ptr);
+		deleter = nullptr;
+	}
+	owned.resize(size);
+	ptr = owned.data();
+	count = size;
+}
+
+void ImageBuffer::clear()
+{
+	if (deleter) {
+		deleter(ptr);
+		deleter = nullptr;
+	}
+	owned.clear();
+	owned.shrink_to_fit();
+	ptr = 0;
+	count = 0;
+}
+
 void ImageData::Import(char const* path, int channels)
 {
 	Data.clear();
@@ -32,70 +130,425 @@ void ImageData::Import(char const* path, int channels)
 	}
 #endif
 
-	stbi_set_flip_vertically_on_load(true);
+	uint64_t params = s_CacheParams('I', channels);
+	AssetArchive cache;
+	if (AssetCache::Load(path, params, cache) && cache.Find("image") >= 0)
+		return Import(cache, "image");
+
+	stbi_set_flip_vertically_on_load_thread(true);
 	int ch;
 	stbi_uc* dat = stbi_load(path, &Size.x, &Size.y, &ch, channels);
-	Channels = channels == 0 || ch < channels ? ch : channels;
+	Channels = channels ? channels : ch; // stb converts to the requested channels.
 
 	if (!dat) [[unlikely]] {
 		MAYA_MAKE_ERROR(FILE_FORMAT_ERROR,
 			"Error while loading image file \"" + stl::string(path) + "\": " + stl::string(stbi_failure_reason()));
+		return;
+	}
+
+	Data.Adopt(dat, static_cast<size_t>(Size.x) * Size.y * Channels, [](unsigned char* p) { stbi_image_free(p); });
+
+	if (!AssetCache::GetDirectory().empty()) {
+		AssetArchiveWriter writer;
+		writer.Add("image", *this);
+		AssetCache::Store(path, params, writer);
+	}
+}
+
+bool ImageData::Decode(ConstBuffer<void> file, int channels)
+{
+	Data.clear();
+	stbi_set_flip_vertically_on_load_thread(true);
+	int ch;
+	stbi_uc* dat = stbi_load_from_memory(static_cast<stbi_uc const*>(file.Data), static_cast<int>(file.Size),
+		&Size.x, &Size.y, &ch, channels);
+	if (!dat) return false;
+
+	Channels = channels ? channels : ch;
+	Data.Adopt(dat, static_cast<size_t>(Size.x) * Size.y * Channels, [](unsigned char* p) { stbi_image_free(p); });
+	return true;
+}
+
+void ImageBatchData::Import(stl::list<stl::string> const& paths, int channels, unsigned threads)
+{
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+
+	Images.clear();
+	Images.resize(paths.size());
+	if (!threads)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, static_cast<unsigned>(std::max<size_t>(paths.size(), 1)));
+
+	stl::list<std::pair<CoreManager::ErrorCode, stl::string>> errors(paths.size());
+	std::atomic<int64_t> readtime = 0, decodetime = 0;
+	std::atomic<size_t> bytes = 0;
+	auto nanoseconds = [](clock::duration d) {
+		return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	};
+
+	{
+		// Reads of later files stay in flight while the pool decodes the files already read.
+		ThreadPool decoders(threads);
+		AsyncFileReader reader(&decoders);
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			reader.Read(paths[i], [&, i, queued = clock::now()](stl::list<unsigned char>& file, bool ok) {
+				auto t1 = clock::now();
+				readtime += nanoseconds(t1 - queued);
+				if (!ok) {
+					errors[i] = { CoreManager::FILE_NOT_FOUND_ERROR, "Unable to find file \"" + paths[i] + "\"" };
+					return;
+				}
+				bytes += file.size();
+
+				bool decoded = Images[i].Decode({ file.data(), file.size() }, channels);
+				decodetime += nanoseconds(clock::now() - t1);
+				if (!decoded) {
+					errors[i] = { CoreManager::FILE_FORMAT_ERROR,
+						"Error while loading image file \"" + paths[i] + "\": " + stbi_failure_reason() };
+				}
+			});
+		}
+		reader.Wait();
+	}
+
+	ReadTime = readtime * 1e-9f;
+	DecodeTime = decodetime * 1e-9f;
+	FileBytes = bytes;
+
+	// Errors are reported here since the error queue is not thread safe.
+	FailedCount = 0;
+	for (auto& [code, msg] : errors) {
+		if (msg.empty()) continue;
+		FailedCount++;
+		CoreManager::Instance()->MakeError(code, msg);
+	}
+
+	WallTime = std::chrono::duration<float>(clock::now() - start).count();
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(char const* path)
+{
+	Close();
+	auto error = [&](char const* reason) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR,
+			"Unable to map file \"" + stl::string(path) + "\": " + reason);
+		return false;
+	};
+
+#if MAYA_PLATFORM_WINDOWS
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return error("cannot open");
+	LARGE_INTEGER filesize;
+	GetFileSizeEx(file, &filesize);
+	if (!filesize.QuadPart) {
+		CloseHandle(file);
+		return error("file is empty");
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping) return error("cannot create mapping");
+	void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view) return error("cannot map view");
+	size = static_cast<MAYA_STL size_t>(filesize.QuadPart);
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return error("cannot open");
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !st.st_size) {
+		close(fd);
+		return error("file is empty");
+	}
+	void* view = mmap(nullptr, static_cast<MAYA_STL size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED) return error("mmap failed");
+	size = static_cast<MAYA_STL size_t>(st.st_size);
+#endif
+	ptr = static_cast<unsigned char*>(view);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!ptr) return;
+#if MAYA_PLATFORM_WINDOWS
+	UnmapViewOfFile(ptr);
+#else
+	munmap(ptr, size);
+#endif
+	ptr = 0;
+	size = 0;
+}
+
+void MappedFile::Prefetch(MAYA_STL size_t offset, MAYA_STL size_t length) const
+{
+	if (!ptr || offset >= size) return;
+	length = MAYA_STL min(length, size - offset);
+#if MAYA_PLATFORM_WINDOWS
+	WIN32_MEMORY_RANGE_ENTRY range = { ptr + offset, length };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	static MAYA_STL size_t const pagesize = static_cast<MAYA_STL size_t>(sysconf(_SC_PAGESIZE));
+	MAYA_STL size_t base = offset - offset % pagesize;
+	madvise(ptr + base, offset - base + length, MADV_WILLNEED);
+#endif
+}
+
+void ImageData::Map(char const* path, Ivec2 size, int channels, MAYA_STL size_t offset)
+{
+	Data.clear();
+	Size = size;
+	Channels = channels;
+	MAYA_STL size_t bytes = static_cast<MAYA_STL size_t>(size.x) * size.y * channels;
+
+	auto file = MAYA_STL make_shared<MappedFile>();
+	if (!file->Open(path)) return;
+	if (file->GetSize() < offset + bytes) {
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_FORMAT_ERROR,
+			"Unable to map file \"" + stl::string(path) + "\": file is smaller than the image");
+		return;
+	}
+	Data.Adopt(file->GetData() + offset, bytes, [file](unsigned char*) {});
+}
+
+// Largest side accepted from a compressed image header, beyond any device limit.
+static constexpr unsigned s_MaxCompressedSide = 0x8000;
+
+// Returns false if the header sizes cannot describe a real image.
+static bool s_CheckCompressedHeader(Ivec2 size, unsigned levels)
+{
+	if (size.x <= 0 || size.y <= 0 || static_cast<unsigned>(MAYA_STL max(size.x, size.y)) > s_MaxCompressedSide)
+		return false;
+	unsigned maxlevels = 1;
+	while ((MAYA_STL max(size.x, size.y) >> maxlevels) > 0)
+		maxlevels++;
+	return levels <= maxlevels;
+}
+
+size_t GetCompressedLevelSize(CompressedFormat format, Ivec2 size, unsigned level)
+{
+	int blockbytes = format == BC1_FORMAT || format == BC4_FORMAT ? 8 : 16;
+	int w = std::max(size.x >> level, 1), h = std::max(size.y >> level, 1);
+	return static_cast<size_t>((w + 3) / 4) * ((h + 3) / 4) * blockbytes;
+}
+
+// Warning: this assume little endian is employed in the system.
+static bool s_ImportDds(std::ifstream& ifs, CompressedImageData& image)
+{
+	uint32_t header[31]; // size, flags, height, width, pitch, depth, mipmaps, reserved[11], pixel format[8], caps[5].
+	ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!ifs || header[3] > s_MaxCompressedSide || header[2] > s_MaxCompressedSide)
+		return false;
+	image.Size = Ivec2(header[3], header[2]);
+	unsigned levels = header[6] ? header[6] : 1;
+	if (!s_CheckCompressedHeader(image.Size, levels))
+		return false;
+
+	char fourcc[5] = { 0 };
+	std::memcpy(fourcc, &header[20], 4);
+	stl::strview cc = fourcc;
+
+	if (cc == "DXT1") image.Format = BC1_FORMAT;
+	else if (cc == "DXT5") image.Format = BC3_FORMAT;
+	else if (cc == "ATI1" || cc == "BC4U") image.Format = BC4_FORMAT;
+	else if (cc == "ATI2" || cc == "BC5U") image.Format = BC5_FORMAT;
+	else if (cc == "DX10")
+	{
+		uint32_t dx10[5]; // dxgi format, dimension, misc flags, array size, misc flags 2.
+		ifs.read(reinterpret_cast<char*>(dx10), sizeof(dx10));
+		switch (dx10[0]) {
+			case 70: case 71: case 72: image.Format = BC1_FORMAT; break;
+			case 76: case 77: case 78: image.Format = BC3_FORMAT; break;
+			case 79: case 80: image.Format = BC4_FORMAT; break;
+			case 82: case 83: image.Format = BC5_FORMAT; break;
+			default: return false;
+		}
+	}
+	else return false;
+
+	image.Levels.resize(levels);
+	for (unsigned i = 0; i < levels && ifs; i++) {
+		image.Levels[i].resize(GetCompressedLevelSize(image.Format, image.Size, i));
+		ifs.read(reinterpret_cast<char*>(image.Levels[i].data()), image.Levels[i].size());
+	}
+	return static_cast<bool>(ifs);
+}
+
+// Warning: this assume little endian is employed in the system.
+static bool s_ImportKtx(std::ifstream& ifs, CompressedImageData& image)
+{
+	// endianness, type, type size, format, internal format, base internal format,
+	// width, height, depth, array elements, faces, mipmaps, key value bytes.
+	uint32_t header[13];
+	ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!ifs || header[0] != 0x04030201)
+		return false;
+
+	switch (header[4]) {
+		case 0x83F0: case 0x83F1: image.Format = BC1_FORMAT; break;
+		case 0x83F3: image.Format = BC3_FORMAT; break;
+		case 0x8DBB: image.Format = BC4_FORMAT; break;
+		case 0x8DBD: image.Format = BC5_FORMAT; break;
+		default: return false;
 	}
 
-	Data.insert(Data.end(), dat, dat + Size.x * Size.y);
-	stbi_image_free(dat);
+	if (header[6] > s_MaxCompressedSide || header[7] > s_MaxCompressedSide)
+		return false;
+	image.Size = Ivec2(header[6], std::max(header[7], 1u));
+	unsigned levels = header[11] ? header[11] : 1;
+	if (!s_CheckCompressedHeader(image.Size, levels))
+		return false;
+	ifs.seekg(header[12], std::ios::cur);
+
+	image.Levels.resize(levels);
+	for (unsigned i = 0; i < levels; i++) {
+		uint32_t size;
+		if (!ifs.read(reinterpret_cast<char*>(&size), 4) || size != GetCompressedLevelSize(image.Format, image.Size, i))
+			return false;
+		image.Levels[i].resize(size);
+		ifs.read(reinterpret_cast<char*>(image.Levels[i].data()), size);
+		ifs.seekg(3 - (size + 3) % 4, std::ios::cur); // mip padding.
+	}
+	return static_cast<bool>(ifs);
 }
 
-static void s_LoadChars(RenderContext& rc, FT_Face face, FontData& font)
+void CompressedImageData::Import(char const* path)
+{
+	Levels.clear();
+
+	std::ifstream ifs(path, std::ios::binary);
+	if (!ifs)
+	{
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR,
+			"Unable to find file \"" + stl::string(path) + "\"");
+		return;
+	}
+
+	static constexpr unsigned char ktxid[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	char magic[12];
+	ifs.read(magic, 4);
+	bool ok = false;
+
+	if (std::memcmp(magic, "DDS ", 4) == 0)
+		ok = s_ImportDds(ifs, *this);
+	else if (ifs.read(magic + 4, 8) && std::memcmp(magic, ktxid, 12) == 0)
+		ok = s_ImportKtx(ifs, *this);
+
+	if (!ok) [[unlikely]] {
+		Levels.clear();
+		MAYA_MAKE_ERROR(FILE_FORMAT_ERROR,
+			"Unsupported compressed texture file \"" + stl::string(path) + "\"");
+	}
+}
+
+// Rasterized glyph, layout of the processed font in the asset cache.
+struct s_GlyphRecord
+{
+	uint32_t charcode;
+	int32_t size[2], bearing[2];
+	uint32_t advance;
+};
+
+// Rasterize every glyph of the face into records each followed by its bitmap, rows from bottom to top.
+static void s_RasterizeChars(FT_Face face, stl::list<unsigned char>& out)
 {
 	FT_UInt index;
 	FT_ULong charcode = FT_Get_First_Char(face, &index);
 
-	RenderContext::QuietWait qw(rc);
-
 	while (index != 0)
 	{
 		FT_Load_Glyph(face, index, FT_LOAD_RENDER);
 		auto& map = face->glyph->bitmap;
 
-		std::vector<std::uint32_t> image;
-		image.reserve(map.width * map.rows);
+		s_GlyphRecord record;
+		record.charcode = static_cast<uint32_t>(charcode);
+		record.size[0] = map.width;
+		record.size[1] = map.rows;
+		record.bearing[0] = face->glyph->bitmap_left;
+		record.bearing[1] = face->glyph->bitmap_top;
+		record.advance = face->glyph->advance.x >> 6;
+		auto* bytes = reinterpret_cast<unsigned char const*>(&record);
+		out.insert(out.end(), bytes, bytes + sizeof(record));
 
 		for (unsigned j = map.rows - 1; j != ~0u; j--) {
 			auto x = &map.buffer[j * map.width];
-			image.insert(image.end(), x, x + map.width);
+			out.insert(out.end(), x, x + map.width);
 		}
 
-		rc.WaitForSyncExec([&, charcode, face]()
+		charcode = FT_Get_Next_Char(face, charcode, &index);
+	}
+}
+
+// Create glyph textures from rasterized records, all in one trip to the render thread.
+static void s_UploadChars(RenderContext& rc, ConstBuffer<void> data, FontData& font)
+{
+	auto* bytes = static_cast<unsigned char const*>(data.Data);
+	RenderContext::QuietWait qw(rc);
+
+	rc.WaitForSyncExec([&]()
+	{
+		MAYA_STL size_t pos = 0;
+		while (data.Size - pos >= sizeof(s_GlyphRecord))
 		{
-			auto& g = font.Data[charcode];
+			s_GlyphRecord record;
+			MAYA_STL memcpy(&record, bytes + pos, sizeof(record));
+			pos += sizeof(record);
+			Ivec2 size(record.size[0], record.size[1]);
+			MAYA_STL size_t count = static_cast<MAYA_STL size_t>(size.x) * size.y;
+			if (count > data.Size - pos) break;
+
+			auto& g = font.Data[record.charcode];
 			g.Bitmap.Init(rc);
-			g.Size = Ivec2(map.width, map.rows);
-			g.Bearing = Ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
-			g.Advance = face->glyph->advance.x >> 6;
-			
-			g.Bitmap.CreateContent(image.data(), Ivec2(map.width, map.rows), 4);
+			g.Size = size;
+			g.Bearing = Ivec2(record.bearing[0], record.bearing[1]);
+			g.Advance = record.advance;
+
+			g.Bitmap.CreateContent(bytes + pos, size, 1);
 			g.Bitmap.SetClampToEdge();
 			g.Bitmap.SetFilterLinear();
-		});
-
-		charcode = FT_Get_Next_Char(face, charcode, &index);
-	}
+			pos += count;
+		}
+	});
 }
 
 void FontData::Import(char const* path, int pixelsize, RenderContext& rc)
 {
+	uint64_t params = s_CacheParams('F', pixelsize);
+	AssetArchive cache;
+	if (AssetCache::Load(path, params, cache)) {
+		int index = cache.Find("font");
+		if (index >= 0 && cache.GetEntry(index).Type == RAW_ASSET)
+			return s_UploadChars(rc, cache.GetView(index), *this);
+	}
+
 	FT_Library ft;
 	FT_Init_FreeType(&ft);
 	FT_Face face;
 	FT_New_Face(ft, path, 0, &face);
 	FT_Set_Pixel_Sizes(face, 0, pixelsize);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	s_LoadChars(rc, face, *this);
+	stl::list<unsigned char> glyphs;
+	s_RasterizeChars(face, glyphs);
 
 	FT_Done_Face(face);
 	FT_Done_FreeType(ft);
+
+	if (!AssetCache::GetDirectory().empty()) {
+		AssetArchiveWriter writer;
+		writer.AddRaw("font", { glyphs.data(), glyphs.size() });
+		AssetCache::Store(path, params, writer);
+	}
+	s_UploadChars(rc, { glyphs.data(), glyphs.size() }, *this);
 }
 
 void FontData::Import(ConstBuffer<void> data, int pixelsize, class RenderContext& rc)
@@ -105,110 +558,41 @@ void FontData::Import(ConstBuffer<void> data, int pixelsize, class RenderContext
 	FT_Face face;
 	FT_New_Memory_Face(ft, static_cast<FT_Byte const*>(data.Data), static_cast<FT_Long>(data.Size), 0, &face);
 	FT_Set_Pixel_Sizes(face, 0, pixelsize);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	s_LoadChars(rc, face, *this);
+	stl::list<unsigned char> glyphs;
+	s_RasterizeChars(face, glyphs);
 
 	FT_Done_Face(face);
 	FT_Done_FreeType(ft);
+
+	s_UploadChars(rc, { glyphs.data(), glyphs.size() }, *this);
 }
 
 // Warning: this assume little endian is employed in the system.
 static void s_ImportWav(char const* path, AudioData& audio)
 {
-	std::ifstream ifs(path, std::ios::binary);
-	ifs.seekg(20, std::ios::cur); // skip useless header.
-
-	uint16_t format, ch, bps;
-	ifs.read(reinterpret_cast<char*>(&format), 2);
-	ifs.read(reinterpret_cast<char*>(&ch), 2);
-	ifs.read(reinterpret_cast<char*>(&audio.SampleRate), 4);
-	ifs.seekg(6, std::ios::cur);
-	ifs.read(reinterpret_cast<char*>(&bps), 2);
-	audio.Channels = ch;
-
-	char name[5];
-	ifs.read(name, 4); // this may be "data" or "LIST"
-	name[4] = '\0';
-	if (strcmp(name, "LIST") == 0) { // if LIST chunk presents
-		uint32_t toskip;
-		ifs.read(reinterpret_cast<char*>(&toskip), 4);
-		ifs.seekg(toskip + 4, std::ios::cur);
-	}
-
-	uint32_t datasize; // num samples * channels * bits per sample / 8
-	ifs.read(reinterpret_cast<char*>(&datasize), 4);
-	unsigned capacity = datasize / bps * 8;
-
-	if (format == 1) // Pulse Code Modulation
-	{
-		switch (bps)
-		{
-			case 8: {
-				std::vector<int8_t> tmp(capacity);
-				ifs.read(reinterpret_cast<char*>(tmp.data()), datasize);
-				audio.Samples.insert(audio.Samples.end(), tmp.begin(), tmp.end());
-				for (auto& x: audio.Samples)
-					x /= std::numeric_limits<int8_t>::max();
-
-				break;
-			}
-			case 16: {
-				std::vector<int16_t> tmp(capacity);
-				ifs.read(reinterpret_cast<char*>(tmp.data()), datasize);
-				audio.Samples.insert(audio.Samples.end(), tmp.begin(), tmp.end());
-				for (auto& x : audio.Samples)
-					x /= std::numeric_limits<int16_t>::max();
-				break;
-			}
-			case 32: {
-
-				std::vector<int32_t> tmp(capacity);
-				ifs.read(reinterpret_cast<char*>(tmp.data()), datasize);
-				audio.Samples.insert(audio.Samples.end(), tmp.begin(), tmp.end());
-				for (auto& x : audio.Samples)
-					x /= std::numeric_limits<int32_t>::max();
-				break;
-			}
-			default: {
-				MAYA_MAKE_ERROR(FILE_FORMAT_ERROR,
-					".wav with Pulse Code Modulation and " + std::to_string(bps) + " bits per sample is not supported.");
-			}
-		}
-	}
-	else if (format == 3) // IEEE floating point
-	{
-		switch (bps)
-		{
-			case 32: {
-				ifs.read(reinterpret_cast<char*>(audio.Samples.data()), datasize);
-				break;
-			}
-			case 64: {
-				std::vector<double> tmp(capacity);
-				ifs.read(reinterpret_cast<char*>(tmp.data()), datasize);
-				audio.Samples.insert(audio.Samples.end(), tmp.begin(), tmp.end());
-				break;
-			}
-			default: {
-				MAYA_MAKE_ERROR(FILE_FORMAT_ERROR,
-					".wav audio with IEEE 754 and " + std::to_string(bps) + " bits per sample is not supported.");
-			}
-		}
-	}
-	else
-	{
-		MAYA_MAKE_ERROR(FILE_FORMAT_ERROR,
-			"Unknown .wav format (" + std::to_string(format) + ")");
+	MappedFile file;
+	if (!file.Open(path))
+		return;
+
+	WavFormat format;
+	stl::string reason;
+	if (!format.Parse({ file.GetData(), file.GetSize() }, reason)) {
+		MAYA_MAKE_ERROR(FILE_FORMAT_ERROR, "Unsupported .wav file \"" + stl::string(path) + "\": " + reason);
+		return;
 	}
+
+	audio.Channels = format.Channels;
+	audio.SampleRate = format.SampleRate;
+	audio.Samples.resize(format.DataSize / (format.BitsPerSample / 8));
+	ConvertToFloat(audio.Samples.data(), file.GetData() + format.DataOffset, format.GetSampleFormat(), audio.Samples.size());
 }
 
 static void s_ImportMp3(char const* path, AudioData& src)
 {
-	std::ifstream ifs(path, std::ios::binary);
-	std::vector<uint8_t> data(std::filesystem::file_size(path));
-	ifs.read(reinterpret_cast<char*>(data.data()), data.size());
-	ifs.close();
+	MappedFile file;
+	if (!file.Open(path))
+		return;
 
 	mp3dec_t decoder;
 	mp3dec_init(&decoder);
@@ -218,21 +602,22 @@ static void s_ImportMp3(char const* path, AudioData& src)
 	std::size_t offset = 0;
 
 	while (int sc = mp3dec_decode_frame(
-		&decoder, data.data() + offset, static_cast<int>(data.size() - offset), pcm.data(), &frame_info))
+		&decoder, file.GetData() + offset, static_cast<int>(file.GetSize() - offset), pcm.data(), &frame_info))
 	{
 		if (!offset) {
 			src.Channels = frame_info.channels;
 			src.SampleRate = frame_info.hz;
 		}
-		src.Samples.insert(src.Samples.end(), pcm.begin(), pcm.begin() + sc * src.Channels);
 		offset += frame_info.frame_bytes;
+		if (static_cast<unsigned>(frame_info.channels) != src.Channels)
+			continue;
+		std::size_t at = src.Samples.size(), count = static_cast<std::size_t>(sc) * src.Channels;
+		src.Samples.resize(at + count);
+		ConvertToFloat(src.Samples.data() + at, pcm.data(), S16_SAMPLE, count);
 	}
-
-	for (float& x: src.Samples)
-		x /= std::numeric_limits<int16_t>::max();
 }
 
-void AudioData::Import(char const* path)
+void AudioData::Import(char const* path, unsigned channels, unsigned samplerate)
 {
 #if MAYA_DEBUG
 	if (!std::filesystem::exists(path))
@@ -244,10 +629,100 @@ void AudioData::Import(char const* path)
 	}
 #endif
 
+	Samples.clear();
+	Encoded.clear();
+	EncodedFrames = 0;
+	Storage = FLOAT_STORAGE;
+
+	uint64_t params = s_CacheParams('A', static_cast<int>(channels | samplerate << 8));
+	AssetArchive cache;
+	if (AssetCache::Load(path, params, cache) && cache.Find("audio") >= 0)
+		return Import(cache, "audio");
+
 	auto ext = std::filesystem::path(path).extension();
 
 	if (ext == ".wav") s_ImportWav(path, *this);
 	else if (ext == ".mp3") s_ImportMp3(path, *this);
+	else return;
+
+	if (channels && Channels && channels != Channels) {
+		stl::list<float> remixed(Samples.size() / Channels * channels);
+		RemixChannels(remixed.data(), channels, Samples.data(), Channels, Samples.size() / Channels);
+		Samples.swap(remixed);
+		Channels = channels;
+	}
+
+	if (samplerate && SampleRate && samplerate != SampleRate) {
+		stl::list<float> resampled;
+		ResampleSamples(resampled, Samples.data(), Channels, Samples.size() / Channels, SampleRate, samplerate, HIGH_RESAMPLE);
+		Samples.swap(resampled);
+		SampleRate = samplerate;
+	}
+
+	if (!Samples.empty() && !AssetCache::GetDirectory().empty()) {
+		AssetArchiveWriter writer;
+		writer.Add("audio", *this);
+		AssetCache::Store(path, params, writer);
+	}
 }
 
-}
\ No newline at end of file
+void AudioData::SetStorage(AudioStorage storage)
+{
+	if (storage == Storage || !Channels)
+		return;
+
+	// Encoded samples go back to float before being encoded again.
+	MAYA_STL size_t frames = GetFrameCount();
+	if (Storage != FLOAT_STORAGE) {
+		Samples.resize(frames * Channels);
+		Decode(Samples.data(), 0, frames);
+		stl::list<unsigned char>().swap(Encoded);
+		EncodedFrames = 0;
+		Storage = FLOAT_STORAGE;
+	}
+	if (storage == FLOAT_STORAGE)
+		return;
+
+	if (storage == INT16_STORAGE) {
+		Encoded.resize(Samples.size() * 2);
+		ConvertFromFloat(Encoded.data(), Samples.data(), S16_SAMPLE, Samples.size());
+	}
+	else {
+		Encoded.resize(GetAdpcmSize(Channels, frames));
+		EncodeAdpcm(Encoded.data(), Samples.data(), Channels, frames);
+	}
+	stl::list<float>().swap(Samples);
+	EncodedFrames = frames;
+	Storage = storage;
+}
+
+MAYA_STL size_t AudioData::GetFrameCount() const
+{
+	if (!Channels)
+		return 0;
+	return Storage == FLOAT_STORAGE ? Samples.size() / Channels : EncodedFrames;
+}
+
+MAYA_STL size_t AudioData::Decode(float* out, MAYA_STL size_t first, MAYA_STL size_t count) const
+{
+	MAYA_STL size_t total = GetFrameCount();
+	if (first >= total)
+		return 0;
+	count = MAYA_STL min(count, total - first);
+
+	switch (Storage)
+	{
+	case FLOAT_STORAGE:
+		MAYA_STL memcpy(out, Samples.data() + first * Channels, count * Channels * sizeof(float));
+		break;
+	case INT16_STORAGE:
+		ConvertToFloat(out, Encoded.data() + first * Channels * 2, S16_SAMPLE, count * Channels);
+		break;
+	case ADPCM_STORAGE:
+		DecodeAdpcm(out, Encoded.data(), Channels, first, count);
+		break;
+	}
+	return count;
+}
+
+}
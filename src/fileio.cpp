@@ -0,0 +1,353 @@
+#include <maya/fileio.hpp>
+#include <cstring>
+#include <cerrno>
+
+#if MAYA_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if MAYA_PLATFORM_LINUX && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define MAYA_IO_URING 1
+#endif
+#endif
+
+namespace maya
+{
+
+struct AsyncFileReader::Request
+{
+	stl::string path;
+	Callback done;
+	bool readahead;
+	stl::list<unsigned char> data;
+	MAYA_STL size_t offset = 0;
+	int fd = -1;
+#if MAYA_IO_URING
+	iovec iov;
+#endif
+};
+
+#if !MAYA_PLATFORM_WINDOWS
+
+// Open the file and size the buffer for it.
+static bool s_OpenFile(AsyncFileReader::Request& request)
+{
+	request.fd = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (request.fd < 0) return false;
+	struct stat st;
+	if (fstat(request.fd, &st) != 0) return false;
+	request.data.resize(static_cast<MAYA_STL size_t>(st.st_size));
+	if (request.readahead) {
+#if MAYA_PLATFORM_LINUX
+		posix_fadvise(request.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		posix_fadvise(request.fd, 0, 0, POSIX_FADV_WILLNEED);
+#elif MAYA_PLATFORM_MACOS
+		fcntl(request.fd, F_RDAHEAD, 1);
+#endif
+	}
+	return true;
+}
+
+static void s_CloseFile(AsyncFileReader::Request& request)
+{
+	if (request.fd >= 0) close(request.fd);
+	request.fd = -1;
+}
+
+#endif
+
+// Read the whole file on the calling thread.
+static bool s_ReadWhole(AsyncFileReader::Request& request)
+{
+#if MAYA_PLATFORM_WINDOWS
+	HANDLE file = CreateFileA(request.path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		request.readahead ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	bool ok = GetFileSizeEx(file, &size);
+	if (ok) request.data.resize(static_cast<MAYA_STL size_t>(size.QuadPart));
+	while (ok && request.offset < request.data.size())
+	{
+		DWORD count = static_cast<DWORD>(MAYA_STL min<MAYA_STL size_t>(request.data.size() - request.offset, 1u << 30)), read = 0;
+		ok = ReadFile(file, request.data.data() + request.offset, count, &read, NULL);
+		if (!read) break;
+		request.offset += read;
+	}
+	CloseHandle(file);
+	request.data.resize(request.offset);
+	return ok;
+#else
+	bool ok = s_OpenFile(request);
+	while (ok && request.offset < request.data.size())
+	{
+		ssize_t read = pread(request.fd, request.data.data() + request.offset,
+			request.data.size() - request.offset, static_cast<off_t>(request.offset));
+		if (read < 0 && errno == EINTR) continue;
+		if (read <= 0) {
+			ok = read == 0;
+			break;
+		}
+		request.offset += static_cast<MAYA_STL size_t>(read);
+	}
+	s_CloseFile(request);
+	request.data.resize(request.offset);
+	return ok;
+#endif
+}
+
+#if MAYA_IO_URING
+
+// Submission and completion queues shared with the kernel.
+struct s_Uring
+{
+	int fd;
+	void* sqmap;
+	void* cqmap;
+	MAYA_STL size_t sqsize, cqsize, sqesize;
+	unsigned *sqtail, *sqmask, *sqarray;
+	unsigned *cqhead, *cqtail, *cqmask;
+	io_uring_sqe* sqes;
+	io_uring_cqe* cqes;
+	unsigned unsubmitted;
+};
+
+static void s_DestroyUring(s_Uring* ring)
+{
+	if (ring->sqes) munmap(ring->sqes, ring->sqesize);
+	if (ring->cqmap) munmap(ring->cqmap, ring->cqsize);
+	if (ring->sqmap) munmap(ring->sqmap, ring->sqsize);
+	close(ring->fd);
+	delete ring;
+}
+
+// Returns null if io_uring is unavailable, e.g. an old kernel or blocked by a sandbox.
+static s_Uring* s_CreateUring(unsigned depth)
+{
+	io_uring_params params;
+	MAYA_STL memset(&params, 0, sizeof(params));
+	int fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+	if (fd < 0) return 0;
+
+	auto* ring = new s_Uring();
+	ring->fd = fd;
+	ring->sqsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cqsize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	ring->sqesize = params.sq_entries * sizeof(io_uring_sqe);
+
+	auto map = [fd](MAYA_STL size_t size, off_t offset) {
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+		return p == MAP_FAILED ? nullptr : p;
+	};
+	ring->sqmap = map(ring->sqsize, IORING_OFF_SQ_RING);
+	ring->cqmap = map(ring->cqsize, IORING_OFF_CQ_RING);
+	ring->sqes = static_cast<io_uring_sqe*>(map(ring->sqesize, IORING_OFF_SQES));
+	if (!ring->sqmap || !ring->cqmap || !ring->sqes) {
+		s_DestroyUring(ring);
+		return 0;
+	}
+
+	auto* sq = static_cast<char*>(ring->sqmap);
+	auto* cq = static_cast<char*>(ring->cqmap);
+	ring->sqtail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	ring->sqmask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	ring->sqarray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	ring->cqhead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	ring->cqtail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	ring->cqmask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	ring->unsubmitted = 0;
+	return ring;
+}
+
+// Queue a read of the rest of the file, submitted on the next enter.
+static void s_PushRead(s_Uring& ring, AsyncFileReader::Request* request)
+{
+	unsigned tail = *ring.sqtail;
+	unsigned index = tail & *ring.sqmask;
+	io_uring_sqe& sqe = ring.sqes[index];
+	MAYA_STL memset(&sqe, 0, sizeof(sqe));
+	request->iov.iov_base = request->data.data() + request->offset;
+	request->iov.iov_len = request->data.size() - request->offset;
+	sqe.opcode = IORING_OP_READV;
+	sqe.fd = request->fd;
+	sqe.addr = reinterpret_cast<uint64_t>(&request->iov);
+	sqe.len = 1;
+	sqe.off = request->offset;
+	sqe.user_data = reinterpret_cast<uint64_t>(request);
+	ring.sqarray[index] = index;
+	MAYA_STL atomic_ref<unsigned>(*ring.sqtail).store(tail + 1, MAYA_STL memory_order_release);
+	ring.unsubmitted++;
+}
+
+#endif
+
+AsyncFileReader::AsyncFileReader(ThreadPool* pool, unsigned depth)
+	: pool(pool), depth(MAYA_STL max(depth, 1u)), pending(0), stop(false), ring(0)
+{
+#if MAYA_IO_URING
+	ring = s_CreateUring(this->depth);
+	if (ring) {
+		threads.emplace_back(&AsyncFileReader::RunRing, this);
+		return;
+	}
+#endif
+	unsigned count = MAYA_STL min(this->depth, 8u);
+	for (unsigned i = 0; i < count; i++)
+		threads.emplace_back(&AsyncFileReader::RunPread, this);
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	{
+		MAYA_STL lock_guard lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for (auto& t : threads)
+		t.join();
+	Wait();
+#if MAYA_IO_URING
+	if (ring) s_DestroyUring(static_cast<s_Uring*>(ring));
+#endif
+}
+
+void AsyncFileReader::Read(stl::string path, Callback done, bool readahead)
+{
+	auto* request = new Request();
+	request->path = MAYA_STL move(path);
+	request->done = MAYA_STL move(done);
+	request->readahead = readahead;
+	{
+		MAYA_STL lock_guard lock(mutex);
+		queue.push_back(request);
+		pending++;
+	}
+	wake.notify_one();
+}
+
+void AsyncFileReader::Wait()
+{
+	MAYA_STL unique_lock lock(mutex);
+	idle.wait(lock, [this]() { return !pending; });
+}
+
+void AsyncFileReader::Complete(Request* request, bool ok)
+{
+	auto finish = [this, request, ok]() {
+		request->done(request->data, ok);
+		delete request;
+		MAYA_STL lock_guard lock(mutex);
+		if (!--pending) idle.notify_all();
+	};
+	if (pool) pool->Submit(finish);
+	else finish();
+}
+
+void AsyncFileReader::RunPread()
+{
+	while (true)
+	{
+		Request* request;
+		{
+			MAYA_STL unique_lock lock(mutex);
+			wake.wait(lock, [this]() { return stop || !queue.empty(); });
+			if (queue.empty()) return;
+			request = queue.front();
+			queue.pop_front();
+		}
+		bool ok = s_ReadWhole(*request);
+		Complete(request, ok);
+	}
+}
+
+void AsyncFileReader::RunRing()
+{
+#if MAYA_IO_URING
+	auto& uring = *static_cast<s_Uring*>(ring);
+	stl::list<Request*> batch;
+	unsigned inflight = 0;
+
+	while (true)
+	{
+		batch.clear();
+		{
+			// Only sleep here when nothing is in flight, otherwise the enter below waits for completions.
+			MAYA_STL unique_lock lock(mutex);
+			if (!inflight) wake.wait(lock, [this]() { return stop || !queue.empty(); });
+			if (stop && queue.empty() && !inflight) return;
+			while (!queue.empty() && inflight + batch.size() < depth) {
+				batch.push_back(queue.front());
+				queue.pop_front();
+			}
+		}
+
+		for (auto* request : batch)
+		{
+			if (!s_OpenFile(*request) || request->data.empty()) {
+				bool ok = request->fd >= 0;
+				s_CloseFile(*request);
+				Complete(request, ok);
+				continue;
+			}
+			s_PushRead(uring, request);
+			inflight++;
+		}
+		if (!inflight) continue;
+
+		long submitted = syscall(__NR_io_uring_enter, uring.fd, uring.unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			// The ring is unusable, take back the unsubmitted reads and finish them by pread instead.
+			unsigned tail = *uring.sqtail;
+			for (unsigned i = tail - uring.unsubmitted; i != tail; i++) {
+				auto* request = reinterpret_cast<Request*>(uring.sqes[i & *uring.sqmask].user_data);
+				s_CloseFile(*request);
+				request->offset = 0;
+				Complete(request, s_ReadWhole(*request));
+				inflight--;
+			}
+			MAYA_STL atomic_ref<unsigned>(*uring.sqtail).store(tail - uring.unsubmitted, MAYA_STL memory_order_release);
+			uring.unsubmitted = 0;
+		}
+		else if (submitted > 0) uring.unsubmitted -= static_cast<unsigned>(submitted);
+
+		unsigned head = *uring.cqhead;
+		unsigned tail = MAYA_STL atomic_ref<unsigned>(*uring.cqtail).load(MAYA_STL memory_order_acquire);
+		for (; head != tail; head++)
+		{
+			io_uring_cqe& cqe = uring.cqes[head & *uring.cqmask];
+			auto* request = reinterpret_cast<Request*>(cqe.user_data);
+			int result = cqe.res;
+			if (result == -EINTR || result == -EAGAIN) {
+				s_PushRead(uring, request);
+				continue;
+			}
+			if (result > 0) {
+				request->offset += static_cast<MAYA_STL size_t>(result);
+				if (request->offset < request->data.size()) {
+					s_PushRead(uring, request);
+					continue;
+				}
+			}
+			// A read of 0 bytes means the file shrank since it was opened.
+			request->data.resize(request->offset);
+			s_CloseFile(*request);
+			Complete(request, result >= 0);
+			inflight--;
+		}
+		MAYA_STL atomic_ref<unsigned>(*uring.cqhead).store(head, MAYA_STL memory_order_release);
+	}
+#endif
+}
+
+}
@@ -0,0 +1,205 @@
+#include <maya/dataio.hpp>
+#include <maya/async.hpp>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYA_MIPMAP_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYA_MIPMAP_SSE2 0
+#endif
+
+namespace maya
+{
+
+// Average 2x2 blocks, odd edges are clamped.
+static void s_BoxDownsample(ImageData const& src, ImageData& dst, int y0, int y1)
+{
+	int const ch = src.Channels;
+	int const rowsize = src.Size.x * ch;
+	int const width = dst.Size.x;
+	stl::list<MAYA_STL uint16_t> sum(rowsize);
+
+	for (int y = y0; y < y1; y++)
+	{
+		unsigned char const* r0 = &src.Data[(2 * y) * rowsize];
+		unsigned char const* r1 = &src.Data[MAYA_STL min(2 * y + 1, src.Size.y - 1) * rowsize];
+		unsigned char* out = &dst.Data[y * width * ch];
+
+		// Vertical pass, sum two rows into 16-bit.
+		int i = 0;
+#if MAYA_MIPMAP_SSE2
+		__m128i const zero = _mm_setzero_si128();
+		for (; i + 16 <= rowsize; i += 16) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r0 + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r1 + i));
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&sum[i]), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&sum[i + 8]), hi);
+		}
+#endif
+		for (; i < rowsize; i++)
+			sum[i] = r0[i] + r1[i];
+
+		// Horizontal pass, add neighbouring pixels and round.
+		int x = 0;
+#if MAYA_MIPMAP_SSE2
+		__m128i const two = _mm_set1_epi16(2);
+		auto* s = reinterpret_cast<__m128i const*>(sum.data());
+		if (src.Size.x >= 2 && ch == 4)
+		{
+			for (; x + 4 <= width; x += 4, s += 4) {
+				// each register holds two pixels of four channels.
+				__m128i a = _mm_loadu_si128(s), b = _mm_loadu_si128(s + 1);
+				__m128i c = _mm_loadu_si128(s + 2), d = _mm_loadu_si128(s + 3);
+				__m128i p0 = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+				__m128i p1 = _mm_add_epi16(_mm_unpacklo_epi64(c, d), _mm_unpackhi_epi64(c, d));
+				p0 = _mm_srli_epi16(_mm_add_epi16(p0, two), 2);
+				p1 = _mm_srli_epi16(_mm_add_epi16(p1, two), 2);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(p0, p1));
+			}
+		}
+		else if (src.Size.x >= 2 && ch == 1)
+		{
+			__m128i const ones = _mm_set1_epi16(1);
+			for (; x + 8 <= width; x += 8, s += 2) {
+				__m128i a = _mm_madd_epi16(_mm_loadu_si128(s), ones);
+				__m128i b = _mm_madd_epi16(_mm_loadu_si128(s + 1), ones);
+				__m128i p = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(a, b), two), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(p, p));
+			}
+		}
+#endif
+		for (; x < width; x++) {
+			int x0 = 2 * x * ch, x1 = MAYA_STL min(2 * x + 1, src.Size.x - 1) * ch;
+			for (int k = 0; k < ch; k++)
+				out[x * ch + k] = static_cast<unsigned char>((sum[x0 + k] + sum[x1 + k] + 2) >> 2);
+		}
+	}
+}
+
+static constexpr int s_KaiserTaps = 6;
+
+// Weights of a kaiser windowed sinc for halving, centered between the middle taps.
+static stl::array<float, s_KaiserTaps> s_KaiserWeights()
+{
+	auto bessel0 = [](double x) {
+		double sum = 1, term = 1;
+		for (int k = 1; k < 20; k++) {
+			term *= (x / (2 * k)) * (x / (2 * k));
+			sum += term;
+		}
+		return sum;
+	};
+
+	constexpr double alpha = 4.0, radius = s_KaiserTaps / 2, pi = 3.14159265358979323846;
+	stl::array<float, s_KaiserTaps> weights;
+	double total = 0;
+
+	for (int i = 0; i < s_KaiserTaps; i++) {
+		double d = i - radius + 0.5;
+		double sinc = std::sin(pi * d / 2) / (pi * d / 2);
+		double r = d / radius;
+		double window = bessel0(alpha * std::sqrt(MAYA_STL max(0.0, 1 - r * r))) / bessel0(alpha);
+		weights[i] = static_cast<float>(sinc * window);
+		total += weights[i];
+	}
+
+	for (auto& w : weights)
+		w = static_cast<float>(w / total);
+	return weights;
+}
+
+// Separable kaiser filter, sharper than box at the cost of 6x6 taps.
+static void s_KaiserDownsample(ImageData const& src, ImageData& dst, int y0, int y1)
+{
+	static stl::array<float, s_KaiserTaps> const weights = s_KaiserWeights();
+	int const ch = src.Channels;
+	int const rowsize = src.Size.x * ch;
+	int const width = dst.Size.x;
+	stl::list<float> column(rowsize);
+
+	for (int y = y0; y < y1; y++)
+	{
+		unsigned char const* rows[s_KaiserTaps];
+		for (int k = 0; k < s_KaiserTaps; k++)
+			rows[k] = &src.Data[MAYA_STL clamp(2 * y - s_KaiserTaps / 2 + 1 + k, 0, src.Size.y - 1) * rowsize];
+
+		// Vertical pass into floats.
+		int i = 0;
+#if MAYA_MIPMAP_SSE2
+		__m128i const zero = _mm_setzero_si128();
+		for (; i + 16 <= rowsize; i += 16) {
+			__m128 acc[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			for (int k = 0; k < s_KaiserTaps; k++) {
+				__m128 w = _mm_set1_ps(weights[k]);
+				__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[k] + i));
+				__m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+				acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero))));
+				acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero))));
+				acc[2] = _mm_add_ps(acc[2], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero))));
+				acc[3] = _mm_add_ps(acc[3], _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero))));
+			}
+			for (int j = 0; j < 4; j++)
+				_mm_storeu_ps(&column[i + j * 4], acc[j]);
+		}
+#endif
+		for (; i < rowsize; i++) {
+			float acc = 0;
+			for (int k = 0; k < s_KaiserTaps; k++)
+				acc += weights[k] * rows[k][i];
+			column[i] = acc;
+		}
+
+		// Horizontal pass, round and clamp back to bytes.
+		unsigned char* out = &dst.Data[y * width * ch];
+		for (int x = 0; x < width; x++) {
+			for (int c = 0; c < ch; c++) {
+				float acc = 0;
+				for (int k = 0; k < s_KaiserTaps; k++) {
+					int sx = MAYA_STL clamp(2 * x - s_KaiserTaps / 2 + 1 + k, 0, src.Size.x - 1);
+					acc += weights[k] * column[sx * ch + c];
+				}
+				out[x * ch + c] = static_cast<unsigned char>(MAYA_STL clamp(acc + 0.5f, 0.0f, 255.0f));
+			}
+		}
+	}
+}
+
+void MipmapData::Generate(ImageData const& base, MipmapFilter filter, unsigned threads)
+{
+	Levels.clear();
+
+	if (base.Data.size() < static_cast<MAYA_STL size_t>(base.Size.x) * base.Size.y * base.Channels) [[unlikely]] {
+		MAYA_MAKE_ERROR(OUT_OF_BOUNDS_ERROR, "Image data is smaller than its size and channels.");
+		return;
+	}
+
+	int count = 1;
+	for (int sz = MAYA_STL max(base.Size.x, base.Size.y); sz > 1; sz >>= 1)
+		count++;
+
+	// Reserve so that references to the previous level stay valid.
+	Levels.reserve(count);
+	Levels.push_back(base);
+
+	for (int i = 1; i < count; i++)
+	{
+		ImageData const& src = Levels.back();
+		ImageData dst;
+		dst.Size = { MAYA_STL max(src.Size.x / 2, 1), MAYA_STL max(src.Size.y / 2, 1) };
+		dst.Channels = src.Channels;
+		dst.Data.resize(static_cast<MAYA_STL size_t>(dst.Size.x) * dst.Size.y * dst.Channels);
+
+		ParallelFor(dst.Size.y, threads, [&](int y0, int y1) {
+			if (filter == KAISER_FILTER) s_KaiserDownsample(src, dst, y0, y1);
+			else s_BoxDownsample(src, dst, y0, y1);
+		});
+
+		Levels.push_back(MAYA_STL move(dst));
+	}
+}
+
+}
@@ -0,0 +1,577 @@
+#include <maya/mixer.hpp>
+#include <maya/dataio.hpp>
+#include <maya/audiostream.hpp>
+#include <maya/audioconvert.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYA_MIXER_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYA_MIXER_SSE2 0
+#endif
+
+namespace maya
+{
+
+// A voice word holds the state in the low 2 bits and a generation above them,
+// so a handle to a finished voice never matches the sound that reuses its slot.
+// The API claims free voices, the callback starts them on their play command and frees them when done.
+enum { s_VoiceFree, s_VoiceClaimed, s_VoicePlaying };
+
+struct MixerVoice
+{
+	stl::atomic<unsigned> Word;
+
+	// Owned by the callback.
+	AudioData const* Data;
+	AudioStream* Stream;
+	Resampler* Resample;
+	bool Loop, Stopping;
+	MAYA_STL size_t Frame;
+	float Gain, Pan, Left, Right;
+};
+
+struct MixerState
+{
+	unsigned SampleRate;
+	stl::uptr<MixerVoice[]> Voices;
+	unsigned VoiceCount;
+	stl::atomic<unsigned> Active, Hint;
+	stl::atomic<float> MasterGain;
+	stl::atomic<MAYA_STL uint64_t> Clock;
+
+	// Producers serialize on the mutex, which the callback never takes.
+	MAYA_STL mutex Producer;
+	stl::uptr<AudioCommandQueue> Commands;
+	MAYA_STL uint64_t CommandTime;
+
+	// Producer side, a resampler for each voice and filters shared by source rate.
+	// A resampler is replaced only while its voice is free, so the callback is never reading it.
+	stl::list<Resampler::uptr> Resamplers;
+	stl::list<ResampleFilter::sptr> Filters;
+	ResampleQuality Quality;
+
+	// Callback only, stream reads and channel gathering, resampled frames, and decoded frames.
+	stl::list<float> Scratch, Resampled, Decoded;
+};
+
+static unsigned s_VoiceState(unsigned word) { return word & 3; }
+static unsigned s_VoiceGeneration(unsigned word) { return (word >> 2) & 0xFFFF; }
+
+// Left and right gains of a voice, stereo sources are balanced rather than panned.
+static void s_PanGains(float gain, float pan, unsigned channels, float& left, float& right)
+{
+	pan = MAYA_STL clamp(pan, -1.0f, 1.0f);
+	if (channels == 1) {
+		float angle = (pan + 1.0f) * 0.785398163f;
+		left = gain * MAYA_STL cos(angle);
+		right = gain * MAYA_STL sin(angle);
+	}
+	else {
+		left = gain * MAYA_STL min(1.0f, 1.0f - pan);
+		right = gain * MAYA_STL min(1.0f, 1.0f + pan);
+	}
+}
+
+// Add mono frames to stereo output, with gains ramping from (l, r) by (dl, dr) per frame.
+static void s_MixMono(float* out, float const* src, unsigned frames, float l, float r, float dl, float dr)
+{
+	unsigned i = 0;
+#if MAYA_MIXER_SSE2
+	__m128 g0 = _mm_setr_ps(l, r, l + dl, r + dr);
+	__m128 g1 = _mm_setr_ps(l + 2 * dl, r + 2 * dr, l + 3 * dl, r + 3 * dr);
+	__m128 step = _mm_setr_ps(4 * dl, 4 * dr, 4 * dl, 4 * dr);
+	for (; i + 4 <= frames; i += 4)
+	{
+		__m128 s = _mm_loadu_ps(src + i);
+		__m128 lo = _mm_unpacklo_ps(s, s), hi = _mm_unpackhi_ps(s, s);
+		_mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), _mm_mul_ps(lo, g0)));
+		_mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + i * 2 + 4), _mm_mul_ps(hi, g1)));
+		g0 = _mm_add_ps(g0, step);
+		g1 = _mm_add_ps(g1, step);
+	}
+#endif
+	for (; i < frames; i++) {
+		out[i * 2] += src[i] * (l + dl * i);
+		out[i * 2 + 1] += src[i] * (r + dr * i);
+	}
+}
+
+// Add stereo frames to stereo output, with gains ramping from (l, r) by (dl, dr) per frame.
+static void s_MixStereo(float* out, float const* src, unsigned frames, float l, float r, float dl, float dr)
+{
+	unsigned i = 0;
+#if MAYA_MIXER_SSE2
+	__m128 g0 = _mm_setr_ps(l, r, l + dl, r + dr);
+	__m128 g1 = _mm_setr_ps(l + 2 * dl, r + 2 * dr, l + 3 * dl, r + 3 * dr);
+	__m128 step = _mm_setr_ps(4 * dl, 4 * dr, 4 * dl, 4 * dr);
+	for (; i + 4 <= frames; i += 4)
+	{
+		_mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), _mm_mul_ps(_mm_loadu_ps(src + i * 2), g0)));
+		_mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + i * 2 + 4), _mm_mul_ps(_mm_loadu_ps(src + i * 2 + 4), g1)));
+		g0 = _mm_add_ps(g0, step);
+		g1 = _mm_add_ps(g1, step);
+	}
+#endif
+	for (; i < frames; i++) {
+		out[i * 2] += src[i * 2] * (l + dl * i);
+		out[i * 2 + 1] += src[i * 2 + 1] * (r + dr * i);
+	}
+}
+
+// Add frames of any channel count, sources with more than two channels are downmixed to stereo first.
+// Returns the number of frames mixed, which is less than requested only when gathering into scratch.
+static unsigned s_MixFrames(MixerState* state, float* out, float const* src, unsigned channels, unsigned frames,
+	float l, float r, float dl, float dr)
+{
+	if (channels == 1) {
+		s_MixMono(out, src, frames, l, r, dl, dr);
+		return frames;
+	}
+	if (channels == 2) {
+		s_MixStereo(out, src, frames, l, r, dl, dr);
+		return frames;
+	}
+	frames = MAYA_STL min(frames, static_cast<unsigned>(state->Scratch.size() / 2));
+	float* tmp = state->Scratch.data();
+	RemixChannels(tmp, 2, src, channels, frames);
+	s_MixStereo(out, tmp, frames, l, r, dl, dr);
+	return frames;
+}
+
+// Mix one voice into the buffer, returns false once it has ended.
+static bool s_MixVoice(MixerState* state, MixerVoice& v, float* out, unsigned frames, float tl, float tr)
+{
+	float dl = (tl - v.Left) / frames, dr = (tr - v.Right) / frames;
+	unsigned done = 0;
+	bool alive = true;
+
+	// Resampled frames are produced into their own scratch, in blocks small enough to gather.
+	unsigned channels = v.Data ? v.Data->Channels : v.Stream->GetChannels();
+	unsigned block = static_cast<unsigned>(MAYA_STL min(state->Resampled.size() / channels, state->Scratch.size() / 4));
+	float* resampled = state->Resampled.data();
+
+	if (v.Data)
+	{
+		// Encoded sources are decoded into scratch, only as far as the block needs.
+		MAYA_STL size_t total = v.Data->GetFrameCount();
+		bool encoded = v.Data->Storage != FLOAT_STORAGE;
+		unsigned cap = static_cast<unsigned>(state->Decoded.size() / channels);
+		while (done < frames)
+		{
+			if (v.Frame >= total) {
+				if (!v.Loop || !total) { alive = false; break; }
+				v.Frame = 0;
+			}
+			unsigned target = v.Resample ? MAYA_STL min(frames - done, block) : frames - done;
+			MAYA_STL size_t avail = MAYA_STL min<MAYA_STL size_t>(total - v.Frame, 0x10000000);
+			if (encoded) avail = MAYA_STL min<MAYA_STL size_t>(avail, v.Resample ? v.Resample->GetInputFrames(target) : target);
+			else if (!v.Resample) avail = MAYA_STL min<MAYA_STL size_t>(avail, target);
+			unsigned n = static_cast<unsigned>(encoded ? MAYA_STL min<MAYA_STL size_t>(avail, cap) : avail);
+
+			float const* src = v.Data->Samples.data() + v.Frame * channels;
+			if (encoded) {
+				src = state->Decoded.data();
+				v.Data->Decode(state->Decoded.data(), v.Frame, n);
+			}
+			if (v.Resample) {
+				// A loop feeds the start straight after the end, so the filter runs across the seam.
+				unsigned used;
+				n = v.Resample->Process(resampled, target, src, n, used);
+				v.Frame += used;
+				src = resampled;
+			}
+			n = s_MixFrames(state, out + done * 2, src, channels, n, v.Left + dl * done, v.Right + dr * done, dl, dr);
+			if (!v.Resample)
+				v.Frame += n;
+			done += n;
+		}
+	}
+	else
+	{
+		// A stream behind on decoding leaves silence rather than being waited for.
+		// Streams with more than two channels are read into the upper half, leaving the lower half for gathering.
+		MAYA_STL size_t room = channels > 2 ? state->Scratch.size() / 2 : state->Scratch.size();
+		float* tmp = state->Scratch.data() + state->Scratch.size() - room;
+		unsigned cap = static_cast<unsigned>(room / channels);
+		while (done < frames)
+		{
+			unsigned want = MAYA_STL min(frames - done, cap), n;
+			if (v.Resample) {
+				// Only the input the block needs is read, so none is left over.
+				unsigned target = MAYA_STL min(frames - done, block), used;
+				want = static_cast<unsigned>(MAYA_STL min<MAYA_STL size_t>(v.Resample->GetInputFrames(target), cap));
+				n = want ? v.Stream->Read(tmp, want) : 0;
+				bool behind = n < want;
+				n = v.Resample->Process(resampled, target, tmp, n, used);
+				n = s_MixFrames(state, out + done * 2, resampled, channels, n, v.Left + dl * done, v.Right + dr * done, dl, dr);
+				done += n;
+				if (behind) break;
+				continue;
+			}
+			n = v.Stream->Read(tmp, want);
+			n = s_MixFrames(state, out + done * 2, tmp, channels, n, v.Left + dl * done, v.Right + dr * done, dl, dr);
+			done += n;
+			if (n < want) break;
+		}
+		alive = !v.Stream->IsEndReached();
+	}
+
+	v.Left = tl;
+	v.Right = tr;
+	return alive;
+}
+
+static void s_ApplyCommand(MixerState* state, AudioCommand const& cmd)
+{
+	if (cmd.Kind == AudioCommand::STOP && !cmd.Voice) {
+		for (unsigned i = 0; i < state->VoiceCount; i++)
+			state->Voices[i].Stopping = true;
+		return;
+	}
+
+	MixerVoice& v = state->Voices[(cmd.Voice & 0xFFFF) - 1];
+	unsigned word = v.Word.load(MAYA_STL memory_order_relaxed);
+	if (s_VoiceState(word) == s_VoiceFree || s_VoiceGeneration(word) != cmd.Voice >> 16)
+		return;
+
+	switch (cmd.Kind)
+	{
+	case AudioCommand::PLAY:
+		v.Data = cmd.Data;
+		v.Stream = cmd.Stream;
+		v.Resample = cmd.Resample;
+		if (v.Resample) v.Resample->Reset();
+		v.Loop = cmd.Loop;
+		v.Stopping = false;
+		v.Frame = 0;
+		v.Gain = cmd.Gain;
+		v.Pan = cmd.Pan;
+		s_PanGains(v.Gain * state->MasterGain.load(MAYA_STL memory_order_relaxed), v.Pan,
+			v.Data ? v.Data->Channels : v.Stream->GetChannels(), v.Left, v.Right);
+		v.Word.store(s_VoiceGeneration(word) << 2 | s_VoicePlaying, MAYA_STL memory_order_relaxed);
+		break;
+	case AudioCommand::STOP:
+		v.Stopping = true;
+		break;
+	case AudioCommand::SEEK:
+		if (v.Data) v.Frame = static_cast<MAYA_STL size_t>(cmd.Position);
+		else v.Stream->Seek(cmd.Position);
+		if (v.Resample) v.Resample->Reset();
+		break;
+	case AudioCommand::SET_GAIN:
+		v.Gain = cmd.Gain;
+		break;
+	case AudioCommand::SET_PAN:
+		v.Pan = cmd.Pan;
+		break;
+	default:
+		break;
+	}
+}
+
+static void s_MixVoices(MixerState* state, float* out, unsigned frames)
+{
+	// Parameters are read once per span and ramped to, so the inner loops only multiply and add.
+	float master = state->MasterGain.load(MAYA_STL memory_order_relaxed);
+	for (unsigned i = 0; i < state->VoiceCount; i++)
+	{
+		MixerVoice& v = state->Voices[i];
+		unsigned word = v.Word.load(MAYA_STL memory_order_relaxed);
+		if (s_VoiceState(word) != s_VoicePlaying)
+			continue;
+
+		float tl = 0, tr = 0;
+		if (!v.Stopping)
+			s_PanGains(v.Gain * master, v.Pan, v.Data ? v.Data->Channels : v.Stream->GetChannels(), tl, tr);
+
+		if (!s_MixVoice(state, v, out, frames, tl, tr) || v.Stopping) {
+			v.Word.store(s_VoiceGeneration(word) << 2 | s_VoiceFree, MAYA_STL memory_order_release);
+			state->Active.fetch_sub(1, MAYA_STL memory_order_relaxed);
+		}
+	}
+}
+
+static bool s_MixerCallback(void* userdata, float* out, unsigned frames)
+{
+	MixerState* state = static_cast<MixerState*>(userdata);
+	MAYA_STL fill(out, out + frames * 2, 0.0f);
+
+	// The buffer is split at the frame of each command, so that commands apply sample accurately.
+	MAYA_STL uint64_t clock = state->Clock.load(MAYA_STL memory_order_relaxed);
+	unsigned pos = 0;
+	while (pos < frames)
+	{
+		unsigned end = frames;
+		while (AudioCommand const* cmd = state->Commands->Peek())
+		{
+			if (cmd->Frame > clock + pos) {
+				end = static_cast<unsigned>(MAYA_STL min<MAYA_STL uint64_t>(frames, cmd->Frame - clock));
+				break;
+			}
+			s_ApplyCommand(state, *cmd);
+			state->Commands->Pop();
+		}
+		s_MixVoices(state, out + pos * 2, end - pos);
+		pos = end;
+	}
+
+	state->Clock.store(clock + frames, MAYA_STL memory_order_relaxed);
+	return true;
+}
+
+AudioMixer::AudioMixer(unsigned samplerate, unsigned maxvoices, unsigned framesperbuffer)
+{
+	state = MAYA_STL make_unique<MixerState>();
+	state->SampleRate = samplerate;
+	state->VoiceCount = MAYA_STL clamp(maxvoices, 1u, 0xFFFFu);
+	state->Voices.reset(new MixerVoice[state->VoiceCount]);
+	for (unsigned i = 0; i < state->VoiceCount; i++)
+		state->Voices[i].Word = s_VoiceFree;
+	state->Active = 0;
+	state->Hint = 0;
+	state->MasterGain = 1.0f;
+	state->Clock = 0;
+	state->Commands = MAYA_STL make_unique<AudioCommandQueue>(0x1000);
+	state->CommandTime = 0;
+	state->Resamplers.resize(state->VoiceCount);
+	state->Quality = MEDIUM_RESAMPLE;
+	state->Scratch.resize(0x1000);
+	state->Resampled.resize(0x1000);
+	state->Decoded.resize(0x1000);
+
+	if (output.Open(2, samplerate, framesperbuffer, s_MixerCallback, state.get()))
+		output.Start();
+}
+
+AudioMixer::~AudioMixer()
+{
+	output.Close();
+}
+
+AudioMixer::uptr AudioMixer::MakeUnique(unsigned samplerate, unsigned maxvoices, unsigned framesperbuffer)
+{
+	return uptr(new AudioMixer(samplerate, maxvoices, framesperbuffer));
+}
+
+AudioMixer::sptr AudioMixer::MakeShared(unsigned samplerate, unsigned maxvoices, unsigned framesperbuffer)
+{
+	return sptr(new AudioMixer(samplerate, maxvoices, framesperbuffer));
+}
+
+// Queue a command at the current command time, waiting while the queue is full. Called under the producer mutex.
+static void s_Send(AudioOutput& output, MixerState* state, AudioCommand cmd)
+{
+	cmd.Frame = state->CommandTime;
+	while (!state->Commands->Push(cmd)) {
+		// Nothing drains a full queue while the callback is not running, so the waiting commands apply early.
+		if (!output.IsConcurrent()) {
+			while (AudioCommand const* pending = state->Commands->Peek()) {
+				s_ApplyCommand(state, *pending);
+				state->Commands->Pop();
+			}
+		}
+		else MAYA_STL this_thread::yield();
+	}
+}
+
+// Shared filter from a source rate to the mixer rate, built on first use. Called under the producer mutex.
+static ResampleFilter::sptr const& s_GetFilter(MixerState* state, unsigned srcrate)
+{
+	for (auto const& f : state->Filters)
+		if (f->GetSourceRate() == srcrate && f->GetQuality() == state->Quality)
+			return f;
+	state->Filters.push_back(ResampleFilter::MakeShared(srcrate, state->SampleRate, state->Quality));
+	return state->Filters.back();
+}
+
+// Claim a free voice and send its play command, the callback starts it at the command time.
+static AudioMixer::Voice s_StartVoice(AudioOutput& output, MixerState* state, AudioData const* data, AudioStream* stream,
+	float gain, float pan, bool loop)
+{
+	unsigned channels = data ? data->Channels : stream->GetChannels();
+	unsigned rate = data ? data->SampleRate : stream->GetSampleRate();
+	MAYA_STL lock_guard lock(state->Producer);
+	unsigned start = state->Hint.load(MAYA_STL memory_order_relaxed);
+	for (unsigned k = 0; k < state->VoiceCount; k++)
+	{
+		unsigned i = (start + k) % state->VoiceCount;
+		MixerVoice& v = state->Voices[i];
+		unsigned word = v.Word.load(MAYA_STL memory_order_acquire);
+		if (s_VoiceState(word) != s_VoiceFree)
+			continue;
+
+		unsigned gen = (s_VoiceGeneration(word) + 1) & 0xFFFF;
+		AudioMixer::Voice voice = gen << 16 | (i + 1);
+		AudioCommand cmd = {};
+		cmd.Kind = AudioCommand::PLAY;
+		cmd.Voice = voice;
+		cmd.Gain = gain;
+		cmd.Pan = pan;
+		cmd.Data = data;
+		cmd.Stream = stream;
+		cmd.Loop = loop;
+
+		// The slot is free, so its resampler can be replaced, and is kept for the next sound of the same kind.
+		if (rate && rate != state->SampleRate) {
+			ResampleFilter::sptr const& filter = s_GetFilter(state, rate);
+			Resampler::uptr& rs = state->Resamplers[i];
+			if (!rs || rs->GetFilter() != filter || rs->GetChannels() != channels)
+				rs = Resampler::MakeUnique(channels, filter);
+			cmd.Resample = rs.get();
+		}
+
+		// Only the callback moves a voice out of free once claimed, so a plain store suffices.
+		// The voice is counted before the callback can see it, which may end it and count it off right away.
+		v.Word.store(gen << 2 | s_VoiceClaimed, MAYA_STL memory_order_relaxed);
+		state->Active.fetch_add(1, MAYA_STL memory_order_relaxed);
+		s_Send(output, state, cmd);
+		state->Hint.store(i + 1, MAYA_STL memory_order_relaxed);
+		return voice;
+	}
+	return 0;
+}
+
+// Send a command to a voice, handles that are malformed or ended are ignored.
+static void s_SendVoice(AudioOutput& output, MixerState* state, AudioMixer::Voice voice, AudioCommand cmd)
+{
+	unsigned i = (voice & 0xFFFF) - 1;
+	if (!voice || i >= state->VoiceCount)
+		return;
+	MAYA_STL lock_guard lock(state->Producer);
+	unsigned word = state->Voices[i].Word.load(MAYA_STL memory_order_relaxed);
+	if (s_VoiceState(word) == s_VoiceFree || s_VoiceGeneration(word) != voice >> 16)
+		return;
+	cmd.Voice = voice;
+	s_Send(output, state, cmd);
+}
+
+AudioMixer::Voice AudioMixer::Play(AudioData const* src, float gain, float pan, bool loop)
+{
+	if (!src || !src->Channels)
+		return 0;
+	return s_StartVoice(output, state.get(), src, 0, gain, pan, loop);
+}
+
+AudioMixer::Voice AudioMixer::Play(AudioStream* src, float gain, float pan)
+{
+	if (!src || !src->GetChannels())
+		return 0;
+	return s_StartVoice(output, state.get(), 0, src, gain, pan, false);
+}
+
+void AudioMixer::Stop(Voice voice)
+{
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::STOP;
+	s_SendVoice(output, state.get(), voice, cmd);
+}
+
+void AudioMixer::Seek(Voice voice, MAYA_STL uint64_t frame)
+{
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::SEEK;
+	cmd.Position = frame;
+	s_SendVoice(output, state.get(), voice, cmd);
+}
+
+void AudioMixer::StopAll()
+{
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::STOP;
+	MAYA_STL lock_guard lock(state->Producer);
+	s_Send(output, state.get(), cmd);
+}
+
+void AudioMixer::SetGain(Voice voice, float gain)
+{
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::SET_GAIN;
+	cmd.Gain = gain;
+	s_SendVoice(output, state.get(), voice, cmd);
+}
+
+void AudioMixer::SetPan(Voice voice, float pan)
+{
+	AudioCommand cmd = {};
+	cmd.Kind = AudioCommand::SET_PAN;
+	cmd.Pan = pan;
+	s_SendVoice(output, state.get(), voice, cmd);
+}
+
+bool AudioMixer::IsPlaying(Voice voice) const
+{
+	unsigned i = (voice & 0xFFFF) - 1;
+	if (!voice || i >= state->VoiceCount)
+		return false;
+	unsigned word = state->Voices[i].Word.load(MAYA_STL memory_order_relaxed);
+	return s_VoiceState(word) != s_VoiceFree && s_VoiceGeneration(word) == voice >> 16;
+}
+
+void AudioMixer::SetCommandTime(MAYA_STL uint64_t frame)
+{
+	MAYA_STL lock_guard lock(state->Producer);
+	state->CommandTime = frame;
+}
+
+MAYA_STL uint64_t AudioMixer::GetClock() const
+{
+	return state->Clock.load(MAYA_STL memory_order_relaxed);
+}
+
+void AudioMixer::SetResampleQuality(ResampleQuality quality)
+{
+	MAYA_STL lock_guard lock(state->Producer);
+	state->Quality = quality;
+}
+
+ResampleQuality AudioMixer::GetResampleQuality() const
+{
+	MAYA_STL lock_guard lock(state->Producer);
+	return state->Quality;
+}
+
+void AudioMixer::SetMasterGain(float gain)
+{
+	state->MasterGain = gain;
+}
+
+float AudioMixer::GetMasterGain() const
+{
+	return state->MasterGain;
+}
+
+unsigned AudioMixer::GetActiveVoices() const
+{
+	return state->Active;
+}
+
+unsigned AudioMixer::GetMaxVoices() const
+{
+	return state->VoiceCount;
+}
+
+unsigned AudioMixer::GetSampleRate() const
+{
+	return state->SampleRate;
+}
+
+void AudioMixer::Pause()
+{
+	output.Stop();
+}
+
+void AudioMixer::Resume()
+{
+	output.Start();
+}
+
+bool AudioMixer::IsRunning() const
+{
+	return output.IsActive();
+}
+
+}
@@ -0,0 +1,173 @@
+#include <maya/pipeline.hpp>
+#include <maya/dataio.hpp>
+#include <chrono>
+#include <algorithm>
+
+namespace maya
+{
+
+using s_Clock = MAYA_STL chrono::steady_clock;
+
+static int64_t s_Nanoseconds(s_Clock::duration d)
+{
+	return static_cast<int64_t>(MAYA_STL chrono::duration_cast<MAYA_STL chrono::nanoseconds>(d).count());
+}
+
+AssetPipeline::AssetPipeline(unsigned capacity, unsigned threads)
+	: decoders(threads), reader(&decoders, MAYA_STL max(capacity, 1u)), capacity(MAYA_STL max(capacity, 1u)), inflight(0),
+	reading(0), decoding(0), readtime(0), decodetime(0), uploadtime(0)
+{
+}
+
+AssetPipeline::~AssetPipeline()
+{
+	// Completions touch the members below the reader, so they must finish first.
+	reader.Wait();
+}
+
+AssetPipeline::uptr AssetPipeline::MakeUnique(unsigned capacity, unsigned threads)
+{
+	return uptr(new AssetPipeline(capacity, threads));
+}
+
+AssetPipeline::sptr AssetPipeline::MakeShared(unsigned capacity, unsigned threads)
+{
+	return sptr(new AssetPipeline(capacity, threads));
+}
+
+unsigned AssetPipeline::Load(stl::string path, Decoder decoder)
+{
+	unsigned id = static_cast<unsigned>(done.size());
+	done.push_back(false);
+	cancelled.push_back(false);
+	waiting.push_back({ id, MAYA_STL move(path), MAYA_STL move(decoder) });
+	Issue();
+	return id;
+}
+
+unsigned AssetPipeline::LoadTexture(stl::string path, Texture& texture, bool mipmaps)
+{
+	Texture* tex = &texture;
+	return Load(path, [this, path, tex, mipmaps](stl::list<unsigned char>& data, bool ok) -> stl::fnptr<void()> {
+		auto image = MAYA_STL make_shared<ImageData>();
+		if (!ok || !image->Decode({ data.data(), data.size() })) {
+			MAYA_STL lock_guard lock(mutex);
+			if (ok) errors.emplace_back(CoreManager::FILE_FORMAT_ERROR, "Error while loading image file \"" + path + "\"");
+			else errors.emplace_back(CoreManager::FILE_NOT_FOUND_ERROR, "Unable to find file \"" + path + "\"");
+			return {};
+		}
+		if (!mipmaps) {
+			return [tex, image]() {
+				tex->CreateContent(image->Data.data(), image->Size, image->Channels);
+				tex->SetFilterLinear();
+			};
+		}
+		// Decoders already occupy the pool, so each chain is built on one thread.
+		auto chain = MAYA_STL make_shared<MipmapData>();
+		chain->Generate(*image, BOX_FILTER, 1);
+		return [tex, chain]() {
+			tex->CreateContent(*chain);
+			tex->SetFilterTrilinear();
+		};
+	});
+}
+
+void AssetPipeline::Cancel(unsigned id)
+{
+	if (id >= done.size() || done[id])
+		return;
+	cancelled[id] = true;
+	auto it = MAYA_STL find_if(waiting.begin(), waiting.end(), [id](Item const& item) { return item.Id == id; });
+	if (it != waiting.end()) {
+		waiting.erase(it);
+		done[id] = true;
+	}
+}
+
+void AssetPipeline::Issue()
+{
+	while (inflight < capacity && !waiting.empty())
+	{
+		auto item = MAYA_STL move(waiting.front());
+		waiting.pop_front();
+		inflight++;
+		reading++;
+		reader.Read(MAYA_STL move(item.Path), [this, id = item.Id, decode = MAYA_STL move(item.Decode), queued = s_Clock::now()]
+			(stl::list<unsigned char>& data, bool ok) {
+			auto start = s_Clock::now();
+			readtime += s_Nanoseconds(start - queued);
+			reading--;
+			decoding++;
+			auto upload = decode(data, ok);
+			decodetime += s_Nanoseconds(s_Clock::now() - start);
+			MAYA_STL lock_guard lock(mutex);
+			uploads.push_back({ id, MAYA_STL move(upload) });
+			decoding--;
+		});
+	}
+}
+
+void AssetPipeline::Update(float maxtime)
+{
+	auto start = s_Clock::now();
+	auto limit = start + MAYA_STL chrono::duration_cast<s_Clock::duration>(MAYA_STL chrono::duration<float>(maxtime));
+
+	decltype(errors) failed;
+	{
+		MAYA_STL lock_guard lock(mutex);
+		failed.swap(errors);
+	}
+	// Errors are reported here since the error queue is not thread safe.
+	auto& cm = *CoreManager::Instance();
+	for (auto& [code, msg] : failed)
+		cm.MakeError(code, msg);
+
+	// Uploads go first, so that the slots they free are refilled by reads within the same frame.
+	// At least one upload runs per frame, so the pipeline always makes progress.
+	while (true)
+	{
+		Upload upload;
+		{
+			MAYA_STL lock_guard lock(mutex);
+			if (uploads.empty()) break;
+			upload = MAYA_STL move(uploads.front());
+			uploads.pop_front();
+		}
+		if (upload.Run && !cancelled[upload.Id]) upload.Run();
+		done[upload.Id] = true;
+		inflight--;
+		if (s_Clock::now() >= limit) break;
+	}
+
+	uploadtime += s_Nanoseconds(s_Clock::now() - start);
+	Issue();
+}
+
+bool AssetPipeline::IsDone(unsigned id) const
+{
+	return id < done.size() && done[id];
+}
+
+bool AssetPipeline::IsIdle() const
+{
+	return !inflight && waiting.empty();
+}
+
+AssetPipeline::Stats AssetPipeline::GetStats() const
+{
+	Stats stats;
+	stats.Waiting = static_cast<unsigned>(waiting.size());
+	stats.Reading = reading;
+	stats.Decoding = decoding;
+	{
+		MAYA_STL lock_guard lock(mutex);
+		stats.Uploading = static_cast<unsigned>(uploads.size());
+	}
+	stats.Done = static_cast<unsigned>(MAYA_STL count(done.begin(), done.end(), true));
+	stats.ReadTime = readtime * 1e-9f;
+	stats.DecodeTime = decodetime * 1e-9f;
+	stats.UploadTime = uploadtime * 1e-9f;
+	return stats;
+}
+
+}
@@ -39,6 +39,7 @@ void RenderContext::Init(Window* win)
 	program			= 0;
 	settings		= 0;
 	blendmode		= NO_BLEND;
+	frame			= 0;
 	num_wait		= 0;
 	num_quiet_wait	= 0;
 	threadid		= std::this_thread::get_id();
@@ -47,6 +48,7 @@ void RenderContext::Init(Window* win)
 	GLint num_tex_slots;
 	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &num_tex_slots);
 	textures.resize(num_tex_slots);
+	texturearrays.resize(num_tex_slots);
 }
 
 void RenderContext::Free()
@@ -91,12 +93,21 @@ void RenderContext::SetProgram(ShaderProgram* pg)
 
 void RenderContext::SetTexture(Texture* tex, int slot)
 {
+	if (tex) tex->lastuse = frame;
 	if (textures[slot] == tex) return;
 	glActiveTexture(GL_TEXTURE0 + slot);
 	glBindTexture(GL_TEXTURE_2D, tex ? tex->GetNativeId() : 0);
 	textures[slot] = tex;
 }
 
+void RenderContext::SetTextureArray(TextureArray* tex, int slot)
+{
+	if (texturearrays[slot] == tex) return;
+	glActiveTexture(GL_TEXTURE0 + slot);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tex ? tex->GetNativeId() : 0);
+	texturearrays[slot] = tex;
+}
+
 void RenderContext::Enable(Options set)
 {
 	if (IsEnabled(set)) return;
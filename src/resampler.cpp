@@ -0,0 +1,283 @@
+#include <maya/resampler.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYA_RESAMPLE_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYA_RESAMPLE_SSE2 0
+#endif
+
+#if !MAYA_RESAMPLE_SSE2 && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#define MAYA_RESAMPLE_NEON 1
+#include <arm_neon.h>
+#else
+#define MAYA_RESAMPLE_NEON 0
+#endif
+
+namespace maya
+{
+
+// Ratios with more phases than this interpolate between neighbouring phases of the table.
+static constexpr unsigned s_MaxPhases = 256;
+
+// Input frames buffered per channel beyond the filter length.
+static constexpr unsigned s_HistoryBlock = 256;
+
+// Taps, Kaiser window beta, and cutoff as a fraction of the Nyquist frequency.
+// The cutoff is placed so that the stopband begins at the Nyquist frequency.
+static constexpr struct { unsigned Taps; double Beta, Cutoff; } s_Qualities[] = {
+	{ 8, 4.0, 0.80 },
+	{ 32, 7.0, 0.86 },
+	{ 64, 9.0, 0.91 },
+};
+
+// Modified Bessel function of the first kind, order 0.
+static double s_BesselI0(double x)
+{
+	double sum = 1, term = 1, q = x * x / 4;
+	for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+		term *= q / (double(k) * k);
+		sum += term;
+	}
+	return sum;
+}
+
+ResampleFilter::ResampleFilter(unsigned srcrate, unsigned dstrate, ResampleQuality quality)
+	: srcrate(srcrate), dstrate(dstrate), quality(quality)
+{
+	srcrate = MAYA_STL max(srcrate, 1u);
+	dstrate = MAYA_STL max(dstrate, 1u);
+	unsigned g = MAYA_STL gcd(srcrate, dstrate);
+	up = dstrate / g;
+	down = srcrate / g;
+	phases = MAYA_STL min(up, s_MaxPhases);
+
+	// Downsampling lowers the cutoff to the target rate, and lengthens the filter to keep the transition as sharp.
+	auto const& q = s_Qualities[quality];
+	double ratio = MAYA_STL min(1.0, double(dstrate) / srcrate);
+	double cutoff = 0.5 * q.Cutoff * ratio;
+	taps = MAYA_STL min((static_cast<unsigned>(MAYA_STL ceil(q.Taps / ratio)) + 3) & ~3u, 1024u);
+
+	coefficients.resize(static_cast<MAYA_STL size_t>(phases + 1) * taps);
+	double half = taps / 2, norm = 1 / s_BesselI0(q.Beta);
+	for (unsigned p = 0; p <= phases; p++)
+	{
+		float* h = coefficients.data() + static_cast<MAYA_STL size_t>(p) * taps;
+		double sum = 0;
+		for (unsigned k = 0; k < taps; k++)
+		{
+			double x = k - (half - 1) - double(p) / phases;
+			double t = x / half;
+			double w = MAYA_STL abs(t) < 1 ? s_BesselI0(q.Beta * MAYA_STL sqrt(1 - t * t)) * norm : 0;
+			double s = x == 0 ? 1 : MAYA_STL sin(6.283185307179586 * cutoff * x) / (6.283185307179586 * cutoff * x);
+			h[k] = static_cast<float>(2 * cutoff * s * w);
+			sum += h[k];
+		}
+
+		// Each phase passes DC at unity, so no ripple follows the fractional position.
+		for (unsigned k = 0; k < taps; k++)
+			h[k] = static_cast<float>(h[k] / sum);
+	}
+}
+
+ResampleFilter::sptr ResampleFilter::MakeShared(unsigned srcrate, unsigned dstrate, ResampleQuality quality)
+{
+	return sptr(new ResampleFilter(srcrate, dstrate, quality));
+}
+
+Resampler::Resampler(unsigned channels, unsigned srcrate, unsigned dstrate, ResampleQuality quality)
+	: Resampler(channels, ResampleFilter::MakeShared(srcrate, dstrate, quality))
+{
+}
+
+Resampler::Resampler(unsigned channels, ResampleFilter::sptr filter)
+	: filter(MAYA_STL move(filter)), channels(MAYA_STL max(channels, 1u))
+{
+	stride = this->filter->taps + s_HistoryBlock;
+	history.resize(static_cast<MAYA_STL size_t>(stride) * this->channels);
+	Reset();
+}
+
+Resampler::uptr Resampler::MakeUnique(unsigned channels, unsigned srcrate, unsigned dstrate, ResampleQuality quality)
+{
+	return uptr(new Resampler(channels, srcrate, dstrate, quality));
+}
+
+Resampler::uptr Resampler::MakeUnique(unsigned channels, ResampleFilter::sptr filter)
+{
+	return uptr(new Resampler(channels, MAYA_STL move(filter)));
+}
+
+void Resampler::Reset()
+{
+	// Half the filter of silence precedes the first frame, so output starts aligned with the input.
+	MAYA_STL fill(history.begin(), history.end(), 0.0f);
+	filled = filter->taps / 2 - 1;
+	base = 0;
+	frac = 0;
+}
+
+MAYA_STL size_t Resampler::GetInputFrames(unsigned outframes) const
+{
+	if (!outframes)
+		return 0;
+	MAYA_STL uint64_t last = base + (frac + static_cast<MAYA_STL uint64_t>(outframes - 1) * filter->down) / filter->up;
+	MAYA_STL uint64_t need = last + filter->taps;
+	return need > filled ? static_cast<MAYA_STL size_t>(need - filled) : 0;
+}
+
+// Dot product of x with h, and with the next phase h + n when blending, n is a multiple of 4.
+static float s_Dot(float const* x, float const* h, unsigned n, float blend)
+{
+#if MAYA_RESAMPLE_SSE2
+	__m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+	if (blend == 0.0f) {
+		for (unsigned k = 0; k < n; k += 8) {
+			a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+			if (k + 4 < n) a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(h + k + 4)));
+		}
+		a0 = _mm_add_ps(a0, a1);
+	}
+	else {
+		for (unsigned k = 0; k < n; k += 4) {
+			__m128 s = _mm_loadu_ps(x + k);
+			a0 = _mm_add_ps(a0, _mm_mul_ps(s, _mm_loadu_ps(h + k)));
+			a1 = _mm_add_ps(a1, _mm_mul_ps(s, _mm_loadu_ps(h + n + k)));
+		}
+		a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(a1, a0), _mm_set1_ps(blend)));
+	}
+	a0 = _mm_add_ps(a0, _mm_movehl_ps(a0, a0));
+	a0 = _mm_add_ss(a0, _mm_shuffle_ps(a0, a0, 1));
+	return _mm_cvtss_f32(a0);
+#elif MAYA_RESAMPLE_NEON
+	float32x4_t a0 = vdupq_n_f32(0), a1 = vdupq_n_f32(0);
+	if (blend == 0.0f) {
+		for (unsigned k = 0; k < n; k += 4)
+			a0 = vmlaq_f32(a0, vld1q_f32(x + k), vld1q_f32(h + k));
+	}
+	else {
+		for (unsigned k = 0; k < n; k += 4) {
+			float32x4_t s = vld1q_f32(x + k);
+			a0 = vmlaq_f32(a0, s, vld1q_f32(h + k));
+			a1 = vmlaq_f32(a1, s, vld1q_f32(h + n + k));
+		}
+		a0 = vmlaq_n_f32(a0, vsubq_f32(a1, a0), blend);
+	}
+	return vaddvq_f32(a0);
+#else
+	float a0 = 0, a1 = 0;
+	for (unsigned k = 0; k < n; k++)
+		a0 += x[k] * h[k];
+	if (blend != 0.0f) {
+		for (unsigned k = 0; k < n; k++)
+			a1 += x[k] * h[n + k];
+		a0 += (a1 - a0) * blend;
+	}
+	return a0;
+#endif
+}
+
+unsigned Resampler::Process(float* out, unsigned outframes, float const* in, unsigned inframes, unsigned& consumed)
+{
+	ResampleFilter const& f = *filter;
+	unsigned const step = f.down / f.up, stepfrac = f.down % f.up;
+	unsigned produced = 0;
+	consumed = 0;
+
+	while (produced < outframes)
+	{
+		if (base + f.taps > filled)
+		{
+			if (consumed == inframes)
+				break;
+
+			// Move the frames still needed to the front, and skip input the filter steps over entirely.
+			unsigned keep = filled > base ? filled - base : 0;
+			if (keep && base)
+				for (unsigned c = 0; c < channels; c++) {
+					float* row = history.data() + static_cast<MAYA_STL size_t>(c) * stride;
+					MAYA_STL memmove(row, row + base, keep * sizeof(float));
+				}
+			base = base > filled ? base - filled : 0;
+			filled = keep;
+			unsigned skip = MAYA_STL min(base, inframes - consumed);
+			consumed += skip;
+			base -= skip;
+
+			unsigned n = MAYA_STL min(stride - filled, inframes - consumed);
+			float const* src = in + static_cast<MAYA_STL size_t>(consumed) * channels;
+			for (unsigned c = 0; c < channels; c++) {
+				float* row = history.data() + static_cast<MAYA_STL size_t>(c) * stride + filled;
+				for (unsigned i = 0; i < n; i++)
+					row[i] = src[static_cast<MAYA_STL size_t>(i) * channels + c];
+			}
+			filled += n;
+			consumed += n;
+			continue;
+		}
+
+		// With fewer phases in the table than the ratio needs, the position falls between two of them.
+		float const* h;
+		float blend = 0;
+		if (f.phases == f.up)
+			h = f.coefficients.data() + static_cast<MAYA_STL size_t>(frac) * f.taps;
+		else {
+			MAYA_STL uint64_t q = static_cast<MAYA_STL uint64_t>(frac) * f.phases;
+			h = f.coefficients.data() + static_cast<MAYA_STL size_t>(q / f.up) * f.taps;
+			blend = static_cast<float>(q % f.up) / f.up;
+		}
+
+		for (unsigned c = 0; c < channels; c++)
+			out[static_cast<MAYA_STL size_t>(produced) * channels + c] =
+				s_Dot(history.data() + static_cast<MAYA_STL size_t>(c) * stride + base, h, f.taps, blend);
+		produced++;
+
+		base += step;
+		frac += stepfrac;
+		if (frac >= f.up) {
+			frac -= f.up;
+			base++;
+		}
+	}
+	return produced;
+}
+
+void ResampleSamples(stl::list<float>& dst, float const* src, unsigned channels, MAYA_STL size_t frames,
+	unsigned srcrate, unsigned dstrate, ResampleQuality quality)
+{
+	channels = MAYA_STL max(channels, 1u);
+	MAYA_STL size_t total = static_cast<MAYA_STL size_t>((static_cast<MAYA_STL uint64_t>(frames) * dstrate + srcrate - 1) / srcrate);
+	if (srcrate == dstrate) {
+		dst.assign(src, src + frames * channels);
+		return;
+	}
+	dst.resize(total * channels);
+	if (!total)
+		return;
+
+	Resampler rs(channels, srcrate, dstrate, quality);
+	MAYA_STL size_t done = 0;
+	while (frames && done < total)
+	{
+		unsigned n = static_cast<unsigned>(MAYA_STL min<MAYA_STL size_t>(frames, 0x10000)), used;
+		done += rs.Process(dst.data() + done * channels, static_cast<unsigned>(MAYA_STL min<MAYA_STL size_t>(total - done, 0x10000)),
+			src, n, used);
+		src += static_cast<MAYA_STL size_t>(used) * channels;
+		frames -= used;
+	}
+
+	// The last frames read past the end, which is silence.
+	stl::list<float> silence(static_cast<MAYA_STL size_t>(rs.GetFilter()->GetTaps()) * channels);
+	while (done < total)
+	{
+		unsigned want = static_cast<unsigned>(MAYA_STL min<MAYA_STL size_t>(total - done, 0x10000)), used;
+		unsigned need = static_cast<unsigned>(MAYA_STL min<MAYA_STL size_t>(rs.GetInputFrames(want), rs.GetFilter()->GetTaps()));
+		done += rs.Process(dst.data() + done * channels, want, silence.data(), need, used);
+	}
+}
+
+}
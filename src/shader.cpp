@@ -2,10 +2,101 @@
 #include <maya/window.hpp>
 #include <glad/glad.h>
 #include <fstream>
+#include <filesystem>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+
+#if MAYA_PLATFORM_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 namespace maya
 {
 
+// Compiled shader stage shared between programs.
+struct s_ShaderStage {
+	MAYA_STL uint32_t id;
+	unsigned refcount;
+};
+
+// Stages are only shared within the same context.
+struct s_ShaderStageKey {
+	RenderContext* rc;
+	ShaderProgram::ShaderType type;
+	stl::string source;
+	bool operator==(s_ShaderStageKey const&) const = default;
+};
+
+struct s_ShaderStageKeyHash {
+	MAYA_STL size_t operator()(s_ShaderStageKey const& key) const {
+		MAYA_STL size_t h = MAYA_STL hash<stl::string>{}(key.source);
+		h ^= MAYA_STL hash<void*>{}(key.rc) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= static_cast<MAYA_STL size_t>(key.type) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
+// Shader ids are only unique within a context.
+using s_ShaderStageId = MAYA_STL pair<RenderContext*, MAYA_STL uint32_t>;
+
+struct s_ShaderStageIdHash {
+	MAYA_STL size_t operator()(s_ShaderStageId const& id) const {
+		MAYA_STL size_t h = MAYA_STL hash<void*>{}(id.first);
+		h ^= static_cast<MAYA_STL size_t>(id.second) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
+static MAYA_STL mutex s_stage_mutex;
+static MAYA_STL unordered_map<s_ShaderStageKey, s_ShaderStage, s_ShaderStageKeyHash> s_stage_cache;
+static MAYA_STL unordered_map<s_ShaderStageId, s_ShaderStageKey const*, s_ShaderStageIdHash> s_stage_keys;
+
+// Returns a compiled stage from cache, or 0 if none.
+static MAYA_STL uint32_t s_AcquireShaderStage(s_ShaderStageKey const& key)
+{
+	std::lock_guard<std::mutex> lock(s_stage_mutex);
+	auto it = s_stage_cache.find(key);
+	if (it == s_stage_cache.end())
+		return 0;
+	it->second.refcount++;
+	return it->second.id;
+}
+
+// Register a freshly compiled stage with a single reference.
+static void s_InsertShaderStage(s_ShaderStageKey&& key, MAYA_STL uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(s_stage_mutex);
+	auto [it, inserted] = s_stage_cache.emplace(MAYA_STL move(key), s_ShaderStage{ id, 1 });
+	s_stage_keys[{ it->first.rc, id }] = &it->first;
+}
+
+// Add a reference to a stage already in cache.
+static void s_RetainShaderStage(RenderContext* rc, MAYA_STL uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(s_stage_mutex);
+	auto kit = s_stage_keys.find({ rc, id });
+	if (kit != s_stage_keys.end())
+		s_stage_cache.find(*kit->second)->second.refcount++;
+}
+
+// Drop a reference, the stage is deleted when no program uses it.
+static void s_ReleaseShaderStage(RenderContext* rc, MAYA_STL uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(s_stage_mutex);
+	auto kit = s_stage_keys.find({ rc, id });
+	if (kit == s_stage_keys.end())
+		return;
+	auto it = s_stage_cache.find(*kit->second);
+	if (--it->second.refcount)
+		return;
+	glDeleteShader(id);
+	s_stage_keys.erase(kit);
+	s_stage_cache.erase(it);
+}
+
 ShaderProgram::ShaderProgram(RenderContext& rc)
 {
 	Init(rc);
@@ -37,24 +128,34 @@ void ShaderProgram::Init(RenderContext& rc)
 
 void ShaderProgram::Free()
 {
+	if (reloader)
+		reloader->Unwatch(*this);
 	if (nativeid) {
 		RenderResource::Free();
+		for (auto& id : shaderids) {
+			if (id) s_ReleaseShaderStage(rc, id);
+			id = 0;
+		}
 		glDeleteProgram(nativeid);
 		nativeid = 0;
 	}
 }
 
-void ShaderProgram::CompileShader(ShaderType type, char const* source)
+// Compile a stage or take it from cache, returns 0 on failure.
+static MAYA_STL uint32_t s_CompileShaderStage(RenderContext* rc, ShaderProgram::ShaderType type, char const* source)
 {
+	s_ShaderStageKey key = { rc, type, source };
+	if (auto id = s_AcquireShaderStage(key))
+		return id;
+
 	GLenum gltype = 0;
 	switch (type) {
-		case VERTEX: gltype = GL_VERTEX_SHADER; break;
-		case FRAGMENT: gltype = GL_FRAGMENT_SHADER; break;
-		case GEOMETRY: gltype = GL_GEOMETRY_SHADER; break;
+		case ShaderProgram::VERTEX: gltype = GL_VERTEX_SHADER; break;
+		case ShaderProgram::FRAGMENT: gltype = GL_FRAGMENT_SHADER; break;
+		case ShaderProgram::GEOMETRY: gltype = GL_GEOMETRY_SHADER; break;
 	}
 
-	auto& shader = shaderids[type];
-	shader = glCreateShader(gltype);
+	MAYA_STL uint32_t shader = glCreateShader(gltype);
 	glShaderSource(shader, 1, &source, nullptr);
 	glCompileShader(shader);
 
@@ -68,19 +169,55 @@ void ShaderProgram::CompileShader(ShaderType type, char const* source)
 		glGetShaderInfoLog(shader, 512, NULL, &errmsg[0]);
 
 		switch (type) {
-			case VERTEX: errmsg = "Following error found in vertex shader\n" + errmsg; break;
-			case FRAGMENT: errmsg = "Following error found in fragment shader\n" + errmsg; break;
-			case GEOMETRY: errmsg = "Following error found in geometry shader\n" + errmsg; break;
+			case ShaderProgram::VERTEX: errmsg = "Following error found in vertex shader\n" + errmsg; break;
+			case ShaderProgram::FRAGMENT: errmsg = "Following error found in fragment shader\n" + errmsg; break;
+			case ShaderProgram::GEOMETRY: errmsg = "Following error found in geometry shader\n" + errmsg; break;
 		}
 
 		auto& cm = *CoreManager::Instance();
 		cm.MakeError(cm.SHADER_COMPILE_ERROR, errmsg);
 		glDeleteShader(shader);
-		shader = 0;
+		return 0;
+	}
+
+	s_InsertShaderStage(MAYA_STL move(key), shader);
+	return shader;
+}
+
+static bool s_ReadSourceFile(char const* path, stl::string& out)
+{
+	std::ifstream ifs(path, std::ios::binary);
+	if (!ifs) return false;
+	out.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	return true;
+}
+
+void ShaderProgram::CompileShader(ShaderType type, char const* source)
+{
+	auto& shader = shaderids[type];
+	if (shader) {
+		glDetachShader(nativeid, shader);
+		s_ReleaseShaderStage(rc, shader);
+	}
+
+	shader = s_CompileShaderStage(rc, type, source);
+	if (shader)
+		glAttachShader(nativeid, shader);
+}
+
+void ShaderProgram::CompileShaderFile(ShaderType type, char const* path)
+{
+	stl::string source;
+	if (!s_ReadSourceFile(path, source))
+	{
+		auto& cm = *CoreManager::Instance();
+		cm.MakeError(cm.FILE_NOT_FOUND_ERROR,
+			"Unable to find file \"" + stl::string(path) + "\"");
 		return;
 	}
 
-	glAttachShader(nativeid, shader);
+	sourcepaths[type] = path;
+	CompileShader(type, source.c_str());
 }
 
 void ShaderProgram::LinkProgram()
@@ -107,11 +244,104 @@ void ShaderProgram::LinkProgram()
 		auto& cm = *CoreManager::Instance();
 		cm.MakeError(cm.SHADER_LINK_ERROR, "Following error found while linking shaders : " + errmsg);
 	}
+}
+
+// Copy the values of active uniforms to another program, to should be in use.
+static void s_CopyUniforms(GLuint from, GLuint to)
+{
+	GLint count = 0;
+	glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		char name[256];
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(from, i, sizeof(name), nullptr, &size, &type, name);
+		GLint src = glGetUniformLocation(from, name);
+		GLint dst = glGetUniformLocation(to, name);
+		if (src == -1 || dst == -1)
+			continue;
+
+		float f[16];
+		int n[4];
+		unsigned u[4];
+
+		switch (type) {
+			case GL_FLOAT: glGetUniformfv(from, src, f); glUniform1fv(dst, 1, f); break;
+			case GL_FLOAT_VEC2: glGetUniformfv(from, src, f); glUniform2fv(dst, 1, f); break;
+			case GL_FLOAT_VEC3: glGetUniformfv(from, src, f); glUniform3fv(dst, 1, f); break;
+			case GL_FLOAT_VEC4: glGetUniformfv(from, src, f); glUniform4fv(dst, 1, f); break;
+			case GL_FLOAT_MAT2: glGetUniformfv(from, src, f); glUniformMatrix2fv(dst, 1, false, f); break;
+			case GL_FLOAT_MAT3: glGetUniformfv(from, src, f); glUniformMatrix3fv(dst, 1, false, f); break;
+			case GL_FLOAT_MAT4: glGetUniformfv(from, src, f); glUniformMatrix4fv(dst, 1, false, f); break;
+			case GL_INT: case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+				glGetUniformiv(from, src, n); glUniform1iv(dst, 1, n); break;
+			case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, src, n); glUniform2iv(dst, 1, n); break;
+			case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, src, n); glUniform3iv(dst, 1, n); break;
+			case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, src, n); glUniform4iv(dst, 1, n); break;
+			case GL_UNSIGNED_INT: glGetUniformuiv(from, src, u); glUniform1uiv(dst, 1, u); break;
+			case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, src, u); glUniform2uiv(dst, 1, u); break;
+			case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, src, u); glUniform3uiv(dst, 1, u); break;
+			case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, src, u); glUniform4uiv(dst, 1, u); break;
+		}
+	}
+}
 
-	for (int i = 0; i < shaderids.size(); i++) {
-		if (shaderids[i])
-			glDeleteShader(shaderids[i]);
+bool ShaderProgram::Rebuild(stl::array<stl::string, 3> const& sources)
+{
+	stl::array<MAYA_STL uint32_t, 3> ids = { 0, 0, 0 };
+	GLuint pg = glCreateProgram();
+	bool ok = true;
+
+	for (int i = 0; i < ids.size() && ok; i++)
+	{
+		if (!sources[i].empty())
+			ids[i] = s_CompileShaderStage(rc, static_cast<ShaderType>(i), sources[i].c_str());
+		else if (shaderids[i])
+			s_RetainShaderStage(rc, ids[i] = shaderids[i]); // stage not created from file, reuse it.
+		else
+			continue;
+		if (ids[i]) glAttachShader(pg, ids[i]);
+		else ok = false;
 	}
+
+	if (ok)
+	{
+		glLinkProgram(pg);
+		GLint status;
+		glGetProgramiv(pg, GL_LINK_STATUS, &status);
+		if (!status)
+		{
+			stl::string errmsg;
+			errmsg.resize(512);
+			glGetProgramInfoLog(pg, 512, NULL, &errmsg[0]);
+			auto& cm = *CoreManager::Instance();
+			cm.MakeError(cm.SHADER_LINK_ERROR, "Following error found while linking shaders : " + errmsg);
+			ok = false;
+		}
+	}
+
+	if (!ok)
+	{
+		for (auto id : ids)
+			if (id) s_ReleaseShaderStage(rc, id);
+		glDeleteProgram(pg);
+		return false;
+	}
+
+	glUseProgram(pg);
+	s_CopyUniforms(nativeid, pg);
+	if (rc->GetProgram() != this)
+		glUseProgram(rc->GetProgram() ? rc->GetProgram()->GetNativeId() : 0);
+
+	glDeleteProgram(nativeid);
+	for (auto id : shaderids)
+		if (id) s_ReleaseShaderStage(rc, id);
+	nativeid = pg;
+	shaderids = ids;
+	uniform_location_cache.clear();
+	return true;
 }
 
 int ShaderProgram::FindUniformLocation(stl::strview name)
@@ -172,4 +402,204 @@ MAYA_DEFINE_UNIFORM_MATRIX_FUNCTION(4, 2, glUniformMatrix4x2fv)
 MAYA_DEFINE_UNIFORM_MATRIX_FUNCTION(4, 3, glUniformMatrix4x3fv)
 MAYA_DEFINE_UNIFORM_MATRIX_FUNCTION(4, 4, glUniformMatrix4fv)
 
+static MAYA_STL int64_t s_LastWriteTime(stl::string const& path)
+{
+	std::error_code ec;
+	auto time = std::filesystem::last_write_time(path, ec);
+	return ec ? 0 : static_cast<MAYA_STL int64_t>(time.time_since_epoch().count());
+}
+
+ShaderHotReloader::ShaderHotReloader()
+	: running(true), inotifyfd(-1)
+{
+#if MAYA_PLATFORM_LINUX
+	inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	thread = std::thread(&ShaderHotReloader::WatchFiles, this);
+}
+
+ShaderHotReloader::~ShaderHotReloader()
+{
+	running = false;
+	thread.join();
+#if MAYA_PLATFORM_LINUX
+	if (inotifyfd >= 0)
+		close(inotifyfd);
+#endif
+	for (auto& [program, entry] : entries)
+		program->reloader = 0;
+}
+
+void ShaderHotReloader::Watch(ShaderProgram& program)
+{
+	WatchEntry entry;
+	for (MAYA_STL size_t i = 0; i < entry.Paths.size(); i++)
+	{
+		auto& path = program.sourcepaths[i];
+		entry.Paths[i] = path.empty() ? "" : std::filesystem::absolute(path).lexically_normal().string();
+		entry.Stamps[i] = path.empty() ? 0 : s_LastWriteTime(path);
+		entry.Watches[i] = -1;
+	}
+
+	std::lock_guard<std::mutex> lock(mut);
+
+#if MAYA_PLATFORM_LINUX
+	if (inotifyfd >= 0)
+	{
+		for (MAYA_STL size_t i = 0; i < entry.Paths.size(); i++)
+		{
+			if (entry.Paths[i].empty()) continue;
+			// Watch the directory since editors usually replace the file on save.
+			// The same directory gives back the same descriptor, which is counted per source.
+			auto dir = std::filesystem::path(entry.Paths[i]).parent_path().string();
+			int wd = inotify_add_watch(inotifyfd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd < 0) continue;
+			auto& watch = watchdirs[wd];
+			watch.Path = dir;
+			watch.Refs++;
+			entry.Watches[i] = wd;
+		}
+	}
+#endif
+
+	auto it = entries.find(&program);
+	if (it != entries.end())
+		ReleaseWatches(it->second);
+	if (program.reloader && program.reloader != this)
+		program.reloader->Unwatch(program);
+	program.reloader = this;
+	entries[&program] = MAYA_STL move(entry);
+}
+
+void ShaderHotReloader::Unwatch(ShaderProgram& program)
+{
+	std::lock_guard<std::mutex> lock(mut);
+	auto it = entries.find(&program);
+	if (it != entries.end()) {
+		ReleaseWatches(it->second);
+		entries.erase(it);
+	}
+	pending.erase(&program);
+	program.reloader = 0;
+}
+
+void ShaderHotReloader::ReleaseWatches(WatchEntry const& entry)
+{
+#if MAYA_PLATFORM_LINUX
+	for (int wd : entry.Watches)
+	{
+		auto it = watchdirs.find(wd);
+		if (it == watchdirs.end() || --it->second.Refs)
+			continue;
+		inotify_rm_watch(inotifyfd, wd);
+		watchdirs.erase(it);
+	}
+#endif
+}
+
+void ShaderHotReloader::ApplyChanges()
+{
+	decltype(pending) changes;
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		changes.swap(pending);
+	}
+
+	for (auto& [program, sources] : changes)
+	{
+		if (program->Rebuild(sources)) {
+			MAYA_DEBUG_LOG_INFO("Shader program " + std::to_string(program->GetNativeId()) + " reloaded.");
+		}
+	}
+}
+
+bool ShaderHotReloader::HasPendingChanges() const
+{
+	std::lock_guard<std::mutex> lock(mut);
+	return !pending.empty();
+}
+
+void ShaderHotReloader::WatchFiles()
+{
+#if MAYA_PLATFORM_LINUX
+	if (inotifyfd >= 0)
+	{
+		alignas(inotify_event) char buffer[4096];
+		while (running)
+		{
+			pollfd pfd = { inotifyfd, POLLIN, 0 };
+			if (poll(&pfd, 1, 100) <= 0)
+				continue;
+
+			ssize_t len = read(inotifyfd, buffer, sizeof(buffer));
+			for (ssize_t i = 0; i < len; )
+			{
+				auto* event = reinterpret_cast<inotify_event*>(buffer + i);
+				i += sizeof(inotify_event) + event->len;
+				if (!event->len) continue;
+
+				stl::string path;
+				{
+					std::lock_guard<std::mutex> lock(mut);
+					auto it = watchdirs.find(event->wd);
+					if (it == watchdirs.end()) continue;
+					path = (std::filesystem::path(it->second.Path) / event->name).string();
+				}
+				ReadChanged(path);
+			}
+		}
+		return;
+	}
+#endif
+
+	// Fallback to polling the modification time.
+	while (running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+		stl::list<stl::string> changed;
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			for (auto& [program, entry] : entries) {
+				for (MAYA_STL size_t i = 0; i < entry.Paths.size(); i++) {
+					if (entry.Paths[i].empty()) continue;
+					auto stamp = s_LastWriteTime(entry.Paths[i]);
+					if (stamp == entry.Stamps[i]) continue;
+					entry.Stamps[i] = stamp;
+					changed.push_back(entry.Paths[i]);
+				}
+			}
+		}
+
+		for (auto& path : changed)
+			ReadChanged(path);
+	}
+}
+
+void ShaderHotReloader::ReadChanged(stl::string const& path)
+{
+	stl::list<MAYA_STL pair<ShaderProgram*, stl::array<stl::string, 3>>> affected;
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		for (auto& [program, entry] : entries)
+			if (MAYA_STL find(entry.Paths.begin(), entry.Paths.end(), path) != entry.Paths.end())
+				affected.emplace_back(program, entry.Paths);
+	}
+
+	// Read the sources here so that ApplyChanges only has to compile.
+	for (auto& [program, paths] : affected)
+	{
+		stl::array<stl::string, 3> sources;
+		bool ok = true;
+		for (MAYA_STL size_t i = 0; i < paths.size(); i++)
+			if (!paths[i].empty() && !s_ReadSourceFile(paths[i].c_str(), sources[i]))
+				ok = false;
+		if (!ok) continue;
+
+		std::lock_guard<std::mutex> lock(mut);
+		if (entries.count(program))
+			pending[program] = MAYA_STL move(sources);
+	}
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include <maya/streaming.hpp>
+#include <algorithm>
+#include <fstream>
+
+namespace maya
+{
+
+static unsigned char const s_placeholder[4] = { 0, 0, 0, 0 };
+
+static bool s_ReadFile(stl::string const& path, stl::list<unsigned char>& data)
+{
+	std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+	if (!ifs) return false;
+	data.resize(static_cast<MAYA_STL size_t>(ifs.tellg()));
+	ifs.seekg(0);
+	return ifs.read(reinterpret_cast<char*>(data.data()), data.size()) || data.empty();
+}
+
+TextureStreamer::TextureStreamer(RenderContext& rc, MAYA_STL size_t budget, int lowres)
+	: rc(&rc), budget(budget), lowres(lowres), running(true)
+{
+	entries.reserve(64);
+	thread = std::thread(&TextureStreamer::LoadRequests, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		running = false;
+	}
+	cv.notify_one();
+	thread.join();
+}
+
+TextureStreamer::uptr TextureStreamer::MakeUnique(RenderContext& rc, MAYA_STL size_t budget, int lowres)
+{
+	return uptr(new TextureStreamer(rc, budget, lowres));
+}
+
+TextureStreamer::sptr TextureStreamer::MakeShared(RenderContext& rc, MAYA_STL size_t budget, int lowres)
+{
+	return sptr(new TextureStreamer(rc, budget, lowres));
+}
+
+int TextureStreamer::Add(char const* path, bool mipmaps)
+{
+	Entry entry;
+	entry.Path = path;
+	entry.Mipmaps = mipmaps;
+	entry.Status = EVICTED;
+	entry.Tex = Texture::MakeUnique(*rc);
+	entry.Tex->CreateContent(s_placeholder, Ivec2(1, 1), 4);
+
+	std::lock_guard<std::mutex> lock(mut); // the loading thread reads the paths.
+	entries.push_back(MAYA_STL move(entry));
+	return static_cast<int>(entries.size() - 1);
+}
+
+Texture* TextureStreamer::Acquire(int id)
+{
+	auto& entry = entries[id];
+	if (entry.Status == EVICTED)
+	{
+		entry.Status = LOADING;
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			requests.push_back(id);
+		}
+		cv.notify_one();
+	}
+	return entry.Tex.get();
+}
+
+bool TextureStreamer::IsResident(int id) const
+{
+	return entries[id].Status == RESIDENT;
+}
+
+void TextureStreamer::SetBudget(MAYA_STL size_t budget)
+{
+	this->budget = budget;
+}
+
+MAYA_STL size_t TextureStreamer::GetMemoryUsage() const
+{
+	MAYA_STL size_t total = 0;
+	for (auto& entry : entries)
+		total += entry.Tex->GetMemorySize();
+	return total;
+}
+
+void TextureStreamer::Update(float maxtime)
+{
+	auto& cm = *CoreManager::Instance();
+	float start = cm.GetTimeSince();
+
+	// Upload finished loads within the time budget.
+	while (cm.GetTimeSince() - start < maxtime)
+	{
+		Loaded item;
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			if (loaded.empty()) break;
+			item = MAYA_STL move(loaded.front());
+			loaded.pop_front();
+		}
+
+		auto& entry = entries[item.Id];
+		auto& levels = item.Mipmaps.Levels;
+		if (levels.empty()) {
+			entry.Status = FAILED;
+			cm.MakeError(item.Code, item.Error);
+			continue;
+		}
+
+		entry.Tex->CreateContent(item.Mipmaps);
+		entry.Tex->SetFilterTrilinear();
+		entry.Status = RESIDENT;
+
+		// Keep the small levels for when the texture gets evicted.
+		auto small = MAYA_STL find_if(levels.begin(), levels.end(), [this](ImageData const& image) {
+			return MAYA_STL max(image.Size.x, image.Size.y) <= lowres;
+		});
+		entry.Low.Levels.assign(MAYA_STL make_move_iterator(small), MAYA_STL make_move_iterator(levels.end()));
+	}
+
+	// Evict the least recently used until within budget, textures used this frame are kept.
+	MAYA_STL size_t usage = GetMemoryUsage();
+	while (usage > budget)
+	{
+		Entry* lru = nullptr;
+		for (auto& entry : entries) {
+			if (entry.Status != RESIDENT || entry.Tex->GetLastUseFrame() >= rc->GetFrame())
+				continue;
+			if (!lru || entry.Tex->GetLastUseFrame() < lru->Tex->GetLastUseFrame())
+				lru = &entry;
+		}
+
+		if (!lru) break;
+		usage -= lru->Tex->GetMemorySize();
+		Evict(*lru);
+		usage += lru->Tex->GetMemorySize();
+	}
+}
+
+void TextureStreamer::Evict(Entry& entry)
+{
+	if (entry.Low.Levels.empty())
+		entry.Tex->CreateContent(s_placeholder, Ivec2(1, 1), 4);
+	else
+		entry.Tex->CreateContent(entry.Low);
+	entry.Status = EVICTED;
+}
+
+void TextureStreamer::LoadRequests()
+{
+	for (;;)
+	{
+		int id;
+		stl::string path;
+		bool mipmaps;
+		{
+			std::unique_lock<std::mutex> lock(mut);
+			cv.wait(lock, [this]() { return !running || !requests.empty(); });
+			if (!running) return;
+			id = requests.front();
+			requests.pop_front();
+			path = entries[id].Path;
+			mipmaps = entries[id].Mipmaps;
+		}
+
+		// Only read and decode here, errors are carried to Update on the rendering thread.
+		Loaded item;
+		item.Id = id;
+		stl::list<unsigned char> file;
+		ImageData image;
+		if (!s_ReadFile(path, file)) {
+			item.Code = CoreManager::FILE_NOT_FOUND_ERROR;
+			item.Error = "Unable to find file \"" + path + "\"";
+		}
+		else if (!image.Decode({ file.data(), file.size() })) {
+			item.Code = CoreManager::FILE_FORMAT_ERROR;
+			item.Error = "Error while loading image file \"" + path + "\"";
+		}
+		else if (mipmaps) item.Mipmaps.Generate(image, BOX_FILTER, 1);
+		else item.Mipmaps.Levels.push_back(MAYA_STL move(image));
+
+		std::lock_guard<std::mutex> lock(mut);
+		loaded.push_back(MAYA_STL move(item));
+	}
+}
+
+}
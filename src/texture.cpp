@@ -1,8 +1,11 @@
 #include <maya/texture.hpp>
 #include <maya/window.hpp>
+#include <maya/dataio.hpp>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <stb/stb_image.h>
+#include <algorithm>
+#include <cstring>
 
 namespace maya
 {
@@ -19,6 +22,93 @@ static constexpr GLenum s_TextureFormat(int channels)
 	}
 }
 
+static constexpr GLenum s_TextureInternalFormat(int channels, int bitdepth)
+{
+	constexpr GLenum formats[3][4] = {
+		{ GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 },
+		{ GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F },
+		{ GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F },
+	};
+	if (channels < 1 || channels > 4) return -1;
+	switch (bitdepth)
+	{
+		case 8: return formats[0][channels - 1];
+		case 16: return formats[1][channels - 1];
+		case 32: return formats[2][channels - 1];
+		default: return -1;
+	}
+}
+
+static constexpr GLenum s_TextureDataType(int bitdepth)
+{
+	switch (bitdepth)
+	{
+		case 16: return GL_HALF_FLOAT;
+		case 32: return GL_FLOAT;
+		default: return GL_UNSIGNED_BYTE;
+	}
+}
+
+// Largest alignment that keeps the rows tightly packed.
+static constexpr GLint s_UnpackAlignment(int width, int channels, int bitdepth)
+{
+	int rowbytes = width * channels * bitdepth / 8;
+	if (rowbytes % 8 == 0) return 8;
+	if (rowbytes % 4 == 0) return 4;
+	if (rowbytes % 2 == 0) return 2;
+	return 1;
+}
+
+// From EXT_texture_compression_s3tc.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// From EXT_texture_filter_anisotropic, core since 4.6.
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+// glTexStorage is core since 4.2, not part of the 3.3 loader.
+using s_TexStorage2DProc = void (APIENTRYP)(GLenum, GLsizei, GLenum, GLsizei, GLsizei);
+using s_TexStorage3DProc = void (APIENTRYP)(GLenum, GLsizei, GLenum, GLsizei, GLsizei, GLsizei);
+
+static bool s_HasTextureStorage()
+{
+	return GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2)
+		|| glfwExtensionSupported("GL_ARB_texture_storage");
+}
+
+static s_TexStorage2DProc s_GetTexStorage2D()
+{
+	static s_TexStorage2DProc proc = s_HasTextureStorage()
+		? reinterpret_cast<s_TexStorage2DProc>(glfwGetProcAddress("glTexStorage2D")) : nullptr;
+	return proc;
+}
+
+static s_TexStorage3DProc s_GetTexStorage3D()
+{
+	static s_TexStorage3DProc proc = s_HasTextureStorage()
+		? reinterpret_cast<s_TexStorage3DProc>(glfwGetProcAddress("glTexStorage3D")) : nullptr;
+	return proc;
+}
+
+// Maximum anisotropy supported by the device, 1 if unsupported.
+static float s_MaxAnisotropy()
+{
+	static float value = []() {
+		bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6)
+			|| glfwExtensionSupported("GL_EXT_texture_filter_anisotropic")
+			|| glfwExtensionSupported("GL_ARB_texture_filter_anisotropic");
+		float max = 1.0f;
+		if (supported) glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max);
+		return max;
+	}();
+	return value;
+}
+
 Texture::Texture(RenderContext& rc)
 {
 	Init(rc);
@@ -45,6 +135,11 @@ void Texture::Init(RenderContext& rc)
 	glGenTextures(1, &nativeid);
 	size = { 0, 0 };
 	channels = 0;
+	bitdepth = 0;
+	levels = 0;
+	memsize = 0;
+	lastuse = 0;
+	immutable = false;
 }
 
 void Texture::Free()
@@ -56,11 +151,151 @@ void Texture::Free()
 	}
 }
 
-void Texture::CreateContent(void const* data, Ivec2 size, int channels)
+void Texture::ReleaseImmutable()
 {
+	if (!immutable)
+		return;
+
+	// Immutable storage cannot be respecified, recreate the texture object.
+	int slots = static_cast<int>(rc->GetMaxTextureSlots());
+	for (int i = 0; i < slots; i++)
+		if (rc->GetTexture(i) == this) rc->SetTexture(0, i);
+	glDeleteTextures(1, &nativeid);
+	glGenTextures(1, &nativeid);
+	immutable = false;
+}
+
+bool Texture::AllocateStorage(Ivec2 size, int channels, int bitdepth, int levels)
+{
+	GLenum internal = s_TextureInternalFormat(channels, bitdepth);
+	if (internal == GLenum(-1)) [[unlikely]] {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR,
+			"Texture with " + std::to_string(channels) + " channels and bit depth "
+			+ std::to_string(bitdepth) + " is not supported.");
+		return false;
+	}
+
+	ReleaseImmutable();
+	this->size = size;
+	this->channels = channels;
+	this->bitdepth = bitdepth;
+	this->levels = levels;
+	memsize = 0;
+	for (int i = 0; i < levels; i++)
+		memsize += static_cast<MAYA_STL size_t>(MAYA_STL max(size.x >> i, 1)) * MAYA_STL max(size.y >> i, 1) * channels * bitdepth / 8;
+
 	rc->SetTexture(this, 0);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
-		size.x, size.y, 0, s_TextureFormat(channels), GL_UNSIGNED_BYTE, data);
+
+	if (auto texstorage = s_GetTexStorage2D())
+	{
+		texstorage(GL_TEXTURE_2D, levels, internal, size.x, size.y);
+		immutable = true;
+	}
+	else
+	{
+		for (int i = 0; i < levels; i++) {
+			Ivec2 sz = { MAYA_STL max(size.x >> i, 1), MAYA_STL max(size.y >> i, 1) };
+			glTexImage2D(GL_TEXTURE_2D, i, internal, sz.x, sz.y, 0,
+				s_TextureFormat(channels), s_TextureDataType(bitdepth), nullptr);
+		}
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	return true;
+}
+
+void Texture::CreateContent(void const* data, Ivec2 size, int channels, int bitdepth)
+{
+	if (!AllocateStorage(size, channels, bitdepth, 1))
+		return;
+
+	if (data) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, s_UnpackAlignment(size.x, channels, bitdepth));
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y,
+			s_TextureFormat(channels), s_TextureDataType(bitdepth), data);
+	}
+
+	rc->SetTexture(0, 0);
+}
+
+void Texture::UpdateContent(void const* data, Ivec2 offset, Ivec2 size)
+{
+	rc->SetTexture(this, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, s_UnpackAlignment(size.x, channels, bitdepth));
+	glTexSubImage2D(GL_TEXTURE_2D, 0, offset.x, offset.y, size.x, size.y,
+		s_TextureFormat(channels), s_TextureDataType(bitdepth), data);
+	rc->SetTexture(0, 0);
+}
+
+void Texture::CreateContent(MipmapData const& mipmaps)
+{
+	auto& levels = mipmaps.Levels;
+	int count = static_cast<int>(levels.size());
+	if (!count || !AllocateStorage(levels[0].Size, levels[0].Channels, 8, count))
+		return;
+
+	for (int i = 0; i < count; i++) {
+		auto& image = levels[i];
+		glPixelStorei(GL_UNPACK_ALIGNMENT, s_UnpackAlignment(image.Size.x, image.Channels, 8));
+		glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, image.Size.x, image.Size.y,
+			s_TextureFormat(image.Channels), GL_UNSIGNED_BYTE, image.Data.data());
+	}
+
+	rc->SetTexture(0, 0);
+}
+
+void Texture::CreateContent(CompressedImageData const& image)
+{
+	GLenum internal = 0;
+	int ch = 0;
+	switch (image.Format) {
+		case BC1_FORMAT: internal = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; ch = 3; break;
+		case BC3_FORMAT: internal = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; ch = 4; break;
+		case BC4_FORMAT: internal = GL_COMPRESSED_RED_RGTC1; ch = 1; break;
+		case BC5_FORMAT: internal = GL_COMPRESSED_RG_RGTC2; ch = 2; break;
+		default:
+			MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "Unknown compressed texture format.");
+			return;
+	}
+
+	if ((image.Format == BC1_FORMAT || image.Format == BC3_FORMAT)
+		&& !glfwExtensionSupported("GL_EXT_texture_compression_s3tc")) [[unlikely]]
+	{
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "S3TC texture compression is not supported by the device.");
+		return;
+	}
+
+	if (image.Levels.empty())
+		return;
+
+	ReleaseImmutable();
+	size = image.Size;
+	channels = ch;
+	bitdepth = 8;
+	levels = static_cast<int>(image.Levels.size());
+	memsize = 0;
+	for (auto& level : image.Levels)
+		memsize += level.size();
+	rc->SetTexture(this, 0);
+
+	auto texstorage = s_GetTexStorage2D();
+	if (texstorage) {
+		texstorage(GL_TEXTURE_2D, levels, internal, size.x, size.y);
+		immutable = true;
+	}
+
+	for (int i = 0; i < levels; i++) {
+		Ivec2 sz = { MAYA_STL max(size.x >> i, 1), MAYA_STL max(size.y >> i, 1) };
+		auto& data = image.Levels[i];
+		if (texstorage)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, sz.x, sz.y, internal,
+				static_cast<GLsizei>(data.size()), data.data());
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, internal, sz.x, sz.y, 0,
+				static_cast<GLsizei>(data.size()), data.data());
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
 	rc->SetTexture(0, 0);
 }
 
@@ -85,4 +320,289 @@ void Texture::SetFilterLinear()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 }
 
+void Texture::SetFilterTrilinear(float anisotropy)
+{
+	glBindTexture(GL_TEXTURE_2D, nativeid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+	float maxanisotropy = s_MaxAnisotropy();
+	if (maxanisotropy > 1.0f)
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, MAYA_STL clamp(anisotropy, 1.0f, maxanisotropy));
+}
+
+TextureArray::TextureArray(RenderContext& rc)
+{
+	Init(rc);
+}
+
+TextureArray::~TextureArray()
+{
+	Free();
+}
+
+TextureArray::uptr TextureArray::MakeUnique(RenderContext& rc)
+{
+	return uptr(new TextureArray(rc));
+}
+
+TextureArray::sptr TextureArray::MakeShared(RenderContext& rc)
+{
+	return sptr(new TextureArray(rc));
+}
+
+void TextureArray::Init(RenderContext& rc)
+{
+	RenderResource::Init(rc);
+	glGenTextures(1, &nativeid);
+	size = { 0, 0 };
+	layers = 0;
+	channels = 0;
+	levels = 0;
+	immutable = false;
+}
+
+void TextureArray::Free()
+{
+	if (nativeid) {
+		RenderResource::Free();
+		glDeleteTextures(1, &nativeid);
+		nativeid = 0;
+	}
+}
+
+void TextureArray::CreateContent(Ivec2 size, int layers, int channels, int levels)
+{
+	GLenum internal = s_TextureInternalFormat(channels, 8);
+	if (internal == GLenum(-1)) [[unlikely]] {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR,
+			"Texture array with " + std::to_string(channels) + " channels is not supported.");
+		return;
+	}
+
+	if (immutable)
+	{
+		// Immutable storage cannot be respecified, recreate the texture object.
+		int slots = static_cast<int>(rc->GetMaxTextureSlots());
+		for (int i = 0; i < slots; i++)
+			if (rc->GetTextureArray(i) == this) rc->SetTextureArray(0, i);
+		glDeleteTextures(1, &nativeid);
+		glGenTextures(1, &nativeid);
+		immutable = false;
+	}
+
+	this->size = size;
+	this->layers = layers;
+	this->channels = channels;
+	this->levels = levels;
+
+	rc->SetTextureArray(this, 0);
+
+	if (auto texstorage = s_GetTexStorage3D()) {
+		texstorage(GL_TEXTURE_2D_ARRAY, levels, internal, size.x, size.y, layers);
+		immutable = true;
+	}
+	else {
+		for (int i = 0; i < levels; i++)
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, i, internal, MAYA_STL max(size.x >> i, 1), MAYA_STL max(size.y >> i, 1),
+				layers, 0, s_TextureFormat(channels), GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	rc->SetTextureArray(0, 0);
+}
+
+void TextureArray::SetLayer(int layer, void const* data, int level)
+{
+	Ivec2 sz = { MAYA_STL max(size.x >> level, 1), MAYA_STL max(size.y >> level, 1) };
+	rc->SetTextureArray(this, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, s_UnpackAlignment(sz.x, channels, 8));
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, sz.x, sz.y, 1,
+		s_TextureFormat(channels), GL_UNSIGNED_BYTE, data);
+	rc->SetTextureArray(0, 0);
+}
+
+void TextureArray::SetLayer(int layer, ImageData const& image)
+{
+	if (image.Size != size || image.Channels != channels) [[unlikely]] {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "Image does not match the size and channels of the texture array.");
+		return;
+	}
+	SetLayer(layer, image.Data.data());
+}
+
+void TextureArray::SetLayer(int layer, MipmapData const& mipmaps)
+{
+	if (mipmaps.Levels.empty())
+		return;
+
+	// Check the whole chain first, a level smaller than the array expects would be read past its end.
+	int count = MAYA_STL min(levels, static_cast<int>(mipmaps.Levels.size()));
+	for (int i = 0; i < count; i++) {
+		auto& level = mipmaps.Levels[i];
+		Ivec2 sz = { MAYA_STL max(size.x >> i, 1), MAYA_STL max(size.y >> i, 1) };
+		if (level.Size != sz || level.Channels != channels) [[unlikely]] {
+			MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "Mipmap level " + std::to_string(i)
+				+ " does not match the size and channels of the texture array.");
+			return;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+		SetLayer(layer, mipmaps.Levels[i].Data.data(), i);
+}
+
+void TextureArray::GenerateMipmaps()
+{
+	rc->SetTextureArray(this, 0);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	rc->SetTextureArray(0, 0);
+}
+
+void TextureArray::SetRepeat()
+{
+	rc->SetTextureArray(this, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+void TextureArray::SetClampToEdge()
+{
+	rc->SetTextureArray(this, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void TextureArray::SetFilterLinear()
+{
+	rc->SetTextureArray(this, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
+void TextureArray::SetFilterTrilinear(float anisotropy)
+{
+	rc->SetTextureArray(this, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	float maxanisotropy = s_MaxAnisotropy();
+	if (maxanisotropy > 1.0f)
+		glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY, MAYA_STL clamp(anisotropy, 1.0f, maxanisotropy));
+}
+
+TextureUploader::TextureUploader(RenderContext& rc, MAYA_STL size_t buffersize, int count)
+{
+	Init(rc, buffersize, count);
+}
+
+TextureUploader::~TextureUploader()
+{
+	Free();
+}
+
+TextureUploader::uptr TextureUploader::MakeUnique(RenderContext& rc, MAYA_STL size_t buffersize, int count)
+{
+	return uptr(new TextureUploader(rc, buffersize, count));
+}
+
+TextureUploader::sptr TextureUploader::MakeShared(RenderContext& rc, MAYA_STL size_t buffersize, int count)
+{
+	return sptr(new TextureUploader(rc, buffersize, count));
+}
+
+void TextureUploader::Init(RenderContext& rc)
+{
+	Init(rc, 1 << 22, 3);
+}
+
+void TextureUploader::Init(RenderContext& rc, MAYA_STL size_t buffersize, int count)
+{
+	RenderResource::Init(rc);
+	this->buffersize = buffersize;
+	current = 0;
+	stalls = 0;
+
+	slots.resize(MAYA_STL max(count, 1));
+	for (auto& slot : slots) {
+		glGenBuffers(1, &slot.Buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, buffersize, nullptr, GL_STREAM_DRAW);
+		slot.Fence = nullptr;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// Used as a flag for initialization, the buffers have their own ids.
+	nativeid = slots.empty() ? 0 : slots[0].Buffer;
+}
+
+void TextureUploader::Free()
+{
+	if (nativeid) {
+		RenderResource::Free();
+		for (auto& slot : slots) {
+			if (slot.Fence) glDeleteSync(static_cast<GLsync>(slot.Fence));
+			glDeleteBuffers(1, &slot.Buffer);
+		}
+		slots.clear();
+		nativeid = 0;
+	}
+}
+
+void TextureUploader::Upload(Texture& tex, void const* data, Ivec2 offset, Ivec2 size)
+{
+	int channels = tex.GetChannels(), bitdepth = tex.GetBitDepth();
+	if (size.x <= 0 || size.y <= 0 || !channels)
+		return;
+
+	if (slots.empty()) [[unlikely]] {
+		MAYA_MAKE_ERROR(INVALID_OPERATION_ERROR, "The texture uploader is not initialized.");
+		return;
+	}
+
+	MAYA_STL size_t rowbytes = static_cast<MAYA_STL size_t>(size.x) * channels * bitdepth / 8;
+
+	if (rowbytes > buffersize) [[unlikely]] {
+		MAYA_MAKE_ERROR(OUT_OF_BOUNDS_ERROR, "A row of the upload is larger than the pixel buffer.");
+		return;
+	}
+
+	int bandrows = static_cast<int>(buffersize / rowbytes);
+	auto* pixels = static_cast<unsigned char const*>(data);
+
+	rc->SetTexture(&tex, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, s_UnpackAlignment(size.x, channels, bitdepth));
+
+	for (int y = 0; y < size.y; y += bandrows)
+	{
+		int rows = MAYA_STL min(bandrows, size.y - y);
+		MAYA_STL size_t bytes = rows * rowbytes;
+		auto& slot = slots[current];
+		current = (current + 1) % slots.size();
+
+		// Wait until the GPU has consumed the previous content of this buffer.
+		if (slot.Fence) {
+			GLsync fence = static_cast<GLsync>(slot.Fence);
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				stalls++;
+				glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			}
+			glDeleteSync(fence);
+			slot.Fence = nullptr;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+		void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		MAYA_STL memcpy(dst, pixels + y * rowbytes, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, offset.x, offset.y + y, size.x, rows,
+			s_TextureFormat(channels), s_TextureDataType(bitdepth), nullptr);
+		slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	rc->SetTexture(0, 0);
+}
+
 }
\ No newline at end of file
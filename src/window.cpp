@@ -210,6 +210,7 @@ void Window::SwapBuffers()
 {
 	GLFWwindow* window = static_cast<GLFWwindow*>(nativeptr);
 	glfwSwapBuffers(window);
+	rc.frame++;
 }
 
 void Window::SetPosition(int x, int y)
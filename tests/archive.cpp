@@ -0,0 +1,112 @@
+#include <maya/core.hpp>
+#include <maya/archive.hpp>
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+// Assets written to an archive and imported back.
+
+static int failures = 0;
+
+#define CHECK(cond) if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; failures++; }
+
+static void TestArchive()
+{
+	maya::ImageData image;
+	image.Size = { 300, 200 };
+	image.Channels = 4;
+	image.Data.resize(300 * 200 * 4);
+	for (size_t i = 0; i < image.Data.size(); i++)
+		image.Data[i] = static_cast<unsigned char>(i / 7 % 13 * (i % 4));
+
+	maya::CompressedImageData compressed;
+	compressed.Encode(image, maya::BC1_FORMAT);
+
+	maya::AudioData audio, audio16, adpcm;
+	audio.SampleRate = 44100;
+	audio.Channels = 2;
+	audio.Samples.resize(100001 * 2);
+	for (size_t i = 0; i < audio.Samples.size(); i++)
+		audio.Samples[i] = 0.5f * std::sin(i * 0.01f);
+	audio16 = adpcm = audio;
+	audio16.SetStorage(maya::INT16_STORAGE);
+	adpcm.SetStorage(maya::ADPCM_STORAGE);
+
+	unsigned char raw[5] = { 1, 2, 3, 4, 5 };
+
+	// Layouts that do not match their data must be rejected on import.
+	maya::ImageData shortimage = image;
+	shortimage.Data.resize(100);
+	maya::CompressedImageData shortcompressed = compressed;
+	shortcompressed.Levels.back().pop_back();
+
+	maya::AssetArchiveWriter writer;
+	writer.Add("image", image, true);
+	writer.Add("image.raw", image);
+	writer.Add("compressed", compressed, true);
+	writer.Add("audio", audio, true);
+	writer.Add("audio16", audio16);
+	writer.Add("adpcm", adpcm, true);
+	writer.AddRaw("raw", maya::ConstBuffer<void>(raw, sizeof(raw)), true);
+	writer.Add("short", shortimage);
+	writer.Add("shortcompressed", shortcompressed, true);
+	CHECK(writer.Write("archive.pak"));
+
+	maya::AssetArchive archive;
+	CHECK(archive.Open("archive.pak"));
+	if (!archive.IsOpen())
+		return;
+	CHECK(archive.GetEntryCount() == 9);
+	CHECK(archive.Find("missing") < 0);
+
+	for (char const* name : { "image", "image.raw" }) {
+		maya::ImageData back;
+		back.Import(archive, name);
+		CHECK(back.Size.x == 300 && back.Size.y == 200 && back.Channels == 4);
+		CHECK(back.Data.size() == image.Data.size() && !std::memcmp(back.Data.data(), image.Data.data(), image.Data.size()));
+	}
+
+	maya::CompressedImageData compressedback;
+	compressedback.Import(archive, "compressed");
+	CHECK(compressedback.Format == maya::BC1_FORMAT && compressedback.Levels == compressed.Levels);
+
+	maya::ImageData shortback;
+	shortback.Import(archive, "short");
+	CHECK(shortback.Data.empty());
+	compressedback.Import(archive, "shortcompressed");
+	CHECK(compressedback.Levels.empty());
+
+	// Encoded audio keeps its storage, so it decodes to exactly the same samples.
+	for (auto* source : { &audio, &audio16, &adpcm }) {
+		maya::AudioData back;
+		back.Import(archive, source == &audio ? "audio" : source == &audio16 ? "audio16" : "adpcm");
+		CHECK(back.Storage == source->Storage && back.Channels == 2 && back.SampleRate == 44100);
+		CHECK(back.GetFrameCount() == source->GetFrameCount());
+		std::vector<float> a(source->GetFrameCount() * 2), b(a.size());
+		source->Decode(a.data(), 0, source->GetFrameCount());
+		back.Decode(b.data(), 0, back.GetFrameCount());
+		CHECK(a == b);
+	}
+
+	int index = archive.Find("raw");
+	CHECK(index >= 0);
+	if (index >= 0) {
+		unsigned char rawback[5] = {};
+		CHECK(archive.GetEntry(index).Size == sizeof(raw) && archive.Read(index, rawback));
+		CHECK(!std::memcmp(raw, rawback, sizeof(raw)));
+	}
+
+	archive.Close();
+	std::remove("archive.pak");
+}
+
+int main(int argc, char** argv)
+{
+	maya::CoreManager cm;
+
+	TestArchive();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+#include <maya/core.hpp>
+#include <maya/audio.hpp>
+#include <maya/mixer.hpp>
+#include <maya/dataio.hpp>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+// Renders on the offline backend, so no sound card is needed and every frame is deterministic.
+
+static int failures = 0;
+
+#define CHECK(cond) if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; failures++; }
+
+static void TestPlayerEnd()
+{
+	maya::AudioData audio;
+	audio.SampleRate = 44100;
+	audio.Channels = 2;
+	for (int i = 0; i < 1000; i++) {
+		audio.Samples.push_back(std::sin(i * 0.01f));
+		audio.Samples.push_back(0.5f);
+	}
+
+	maya::AudioPlayer player;
+	player.SetSource(&audio, 256);
+	player.SetVolume(0.5f);
+	player.Start();
+
+	std::vector<float> out(4000 * 2, 1.0f);
+	unsigned frames = player.GetOutput().Render(out.data(), 4000);
+	CHECK(frames >= 1000 && frames < 4000);
+	CHECK(player.IsEndReached());
+	CHECK(!player.IsPlaying());
+
+	bool match = true;
+	for (int i = 0; i < 1000; i++)
+		match = match && std::fabs(out[i * 2] - audio.Samples[i * 2] * 0.5f) < 1e-6f && std::fabs(out[i * 2 + 1] - 0.25f) < 1e-6f;
+	CHECK(match);
+	bool silent = true;
+	for (unsigned i = 1000 * 2; i < frames * 2; i++)
+		silent = silent && out[i] == 0;
+	CHECK(silent);
+
+	// Nothing more once ended.
+	CHECK(player.GetOutput().Render(out.data(), 256) == 0);
+}
+
+static void TestMixerCommandTime()
+{
+	maya::AudioData audio;
+	audio.SampleRate = 48000;
+	audio.Channels = 1;
+	audio.Samples.assign(48000, 0.25f);
+
+	maya::AudioMixer mixer(48000, 8, 128);
+	mixer.SetCommandTime(100);
+	maya::AudioMixer::Voice voice = mixer.Play(&audio);
+	mixer.SetCommandTime(600);
+	mixer.Stop(voice);
+	mixer.SetCommandTime(0);
+	CHECK(voice != 0);
+
+	std::vector<float> out(1000 * 2, 1.0f);
+	CHECK(mixer.GetOutput().Render(out.data(), 1000) == 1000);
+
+	// Silent until the start frame, playing from it on.
+	bool before = true, during = true, after = true;
+	for (int i = 0; i < 100 * 2; i++)
+		before = before && out[i] == 0;
+	for (int i = 100 * 2; i < 600 * 2; i++)
+		during = during && out[i] > 0.1f && std::fabs(out[i] - out[100 * 2]) < 1e-6f;
+	CHECK(before);
+	CHECK(during);
+
+	// Faded out within one buffer of the stop frame.
+	CHECK(out[600 * 2] <= out[599 * 2]);
+	for (int i = (600 + 128) * 2; i < 1000 * 2; i++)
+		after = after && out[i] == 0;
+	CHECK(after);
+	CHECK(!mixer.IsPlaying(voice));
+	CHECK(mixer.GetClock() == 1000);
+}
+
+static void TestMixerFullQueue()
+{
+	maya::AudioData audio;
+	audio.SampleRate = 48000;
+	audio.Channels = 1;
+	audio.Samples.assign(48000, 0.25f);
+
+	// More commands than the queue holds before any render, none of them may be dropped.
+	maya::AudioMixer mixer(48000, 8, 128);
+	maya::AudioMixer::Voice voice = mixer.Play(&audio);
+	for (int i = 0; i < 10000; i++)
+		mixer.SetGain(voice, 0.5f);
+	mixer.StopAll();
+	CHECK(voice != 0);
+	CHECK(mixer.GetActiveVoices() == 1);
+
+	std::vector<float> out(512 * 2);
+	CHECK(mixer.GetOutput().Render(out.data(), 512) == 512);
+	bool silent = true;
+	for (int i = 128 * 2; i < 512 * 2; i++)
+		silent = silent && out[i] == 0;
+	CHECK(silent);
+	CHECK(!mixer.IsPlaying(voice));
+	CHECK(mixer.GetActiveVoices() == 0);
+}
+
+int main(int argc, char** argv)
+{
+	maya::CoreManager cm;
+	maya::AudioOutput::SetBackend(maya::AudioOutput::OFFLINE_BACKEND);
+
+	TestPlayerEnd();
+	TestMixerCommandTime();
+	TestMixerFullQueue();
+
+	return failures ? 1 : 0;
+}
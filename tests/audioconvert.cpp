@@ -0,0 +1,77 @@
+#include <maya/core.hpp>
+#include <maya/audioconvert.hpp>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cmath>
+
+// Sample conversion against exact references, at every length around the vector widths.
+
+static int failures = 0;
+
+#define CHECK(cond) if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; failures++; }
+
+// Exact reference of a sample in each format.
+static double ReferenceSample(unsigned char const* p, maya::SampleFormat format)
+{
+	switch (format) {
+		case maya::U8_SAMPLE: return (p[0] - 128) / 128.0;
+		case maya::S8_SAMPLE: return static_cast<int8_t>(p[0]) / 128.0;
+		case maya::S16_SAMPLE: { int16_t x; std::memcpy(&x, p, 2); return x / 32768.0; }
+		case maya::S24_SAMPLE: return static_cast<int32_t>(p[0] << 8 | p[1] << 16 | static_cast<uint32_t>(p[2]) << 24) / 2147483648.0;
+		case maya::S32_SAMPLE: { int32_t x; std::memcpy(&x, p, 4); return x / 2147483648.0; }
+		case maya::F32_SAMPLE: { float x; std::memcpy(&x, p, 4); return x; }
+		default: { double x; std::memcpy(&x, p, 8); return x; }
+	}
+}
+
+static void TestConvert()
+{
+	std::mt19937 rng(1);
+	for (int f = maya::U8_SAMPLE; f <= maya::F64_SAMPLE; f++) {
+		maya::SampleFormat format = static_cast<maya::SampleFormat>(f);
+		unsigned size = maya::GetSampleSize(format);
+
+		// Counts around the vector widths cover every tail, the source is misaligned on purpose.
+		for (size_t count : { 0, 1, 3, 5, 7, 15, 16, 17, 31, 33, 1001 }) {
+			std::vector<unsigned char> raw(count * size + 1);
+			for (auto& b : raw) b = static_cast<unsigned char>(rng());
+			for (size_t i = 0; i < count; i++) {
+				double x = (static_cast<int>(rng() % 2001) - 1000) / 1000.0;
+				if (format == maya::F32_SAMPLE) { float y = static_cast<float>(x); std::memcpy(&raw[1 + i * 4], &y, 4); }
+				if (format == maya::F64_SAMPLE) std::memcpy(&raw[1 + i * 8], &x, 8);
+			}
+
+			std::vector<float> samples(count + 1, 7.0f);
+			maya::ConvertToFloat(samples.data(), raw.data() + 1, format, count);
+			CHECK(samples[count] == 7.0f);
+			bool exact = true;
+			for (size_t i = 0; i < count; i++)
+				exact = exact && std::fabs(samples[i] - ReferenceSample(&raw[1 + i * size], format)) <= 1e-6;
+			CHECK(exact);
+
+			// Integers up to 24 bits fit a float, so they come back bit exact.
+			std::vector<unsigned char> back(count * size + 2, 0xAB);
+			maya::ConvertFromFloat(back.data() + 1, samples.data(), format, count);
+			CHECK(back[count * size + 1] == 0xAB);
+			if (format != maya::S32_SAMPLE && format != maya::F64_SAMPLE)
+				CHECK(!std::memcmp(back.data() + 1, raw.data() + 1, count * size));
+		}
+	}
+
+	// Out of range samples are clamped.
+	float loud[4] = { 1.5f, -1.5f, 1.0f, -1.0f };
+	int16_t s16[4];
+	maya::ConvertFromFloat(s16, loud, maya::S16_SAMPLE, 4);
+	CHECK(s16[0] == 32767 && s16[1] == -32768 && s16[2] == 32767 && s16[3] == -32768);
+}
+
+int main(int argc, char** argv)
+{
+	maya::CoreManager cm;
+
+	TestConvert();
+
+	return failures ? 1 : 0;
+}
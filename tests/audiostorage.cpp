@@ -0,0 +1,117 @@
+#include <maya/core.hpp>
+#include <maya/audioconvert.hpp>
+#include <maya/dataio.hpp>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cmath>
+
+// Encoded audio storage decoded back and compared to plain references.
+
+static int failures = 0;
+
+#define CHECK(cond) if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; failures++; }
+
+static int16_t const AdpcmSteps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+// Plain IMA decoding one block at a time, what the vectorized decoder must match.
+static void ReferenceAdpcm(float* dst, unsigned char const* src, unsigned channels, size_t frames)
+{
+	static int const indexsteps[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+	for (size_t b = 0; b * maya::AdpcmBlockFrames < frames; b++) {
+		for (unsigned c = 0; c < channels; c++) {
+			unsigned char const* block = src + (b * channels + c) * maya::AdpcmBlockSize;
+			int16_t head;
+			std::memcpy(&head, block, 2);
+			int pred = head, index = std::min<int>(block[2], 88);
+			for (unsigned j = 0; j < maya::AdpcmBlockFrames && b * maya::AdpcmBlockFrames + j < frames; j++) {
+				int code = (block[4 + j / 2] >> (j & 1) * 4) & 15, step = AdpcmSteps[index];
+				int delta = step >> 3;
+				if (code & 4) delta += step;
+				if (code & 2) delta += step >> 1;
+				if (code & 1) delta += step >> 2;
+				pred = std::clamp(code & 8 ? pred - delta : pred + delta, -32768, 32767);
+				index = std::clamp(index + indexsteps[code & 7], 0, 88);
+				dst[(b * maya::AdpcmBlockFrames + j) * channels + c] = pred / 32768.0f;
+			}
+		}
+	}
+}
+
+static void TestAdpcm()
+{
+	std::mt19937 rng(5);
+	for (unsigned channels : { 1, 2, 3 }) {
+		size_t frames = 64 * 21 + 13;
+		std::vector<float> samples(frames * channels);
+		for (size_t i = 0; i < samples.size(); i++)
+			samples[i] = 0.9f * std::sin(i * 0.003f * (1 + i % channels)) + (static_cast<int>(rng() % 2000) - 1000) / 4000.0f;
+
+		std::vector<unsigned char> encoded(maya::GetAdpcmSize(channels, frames));
+		maya::EncodeAdpcm(encoded.data(), samples.data(), channels, frames);
+
+		// Loud noise reaches the clamps, corrupted step indices must be clamped the same way.
+		encoded[2] = 200;
+		encoded[encoded.size() - maya::AdpcmBlockSize + 2] = 255;
+
+		std::vector<float> decoded(frames * channels), reference(frames * channels);
+		maya::DecodeAdpcm(decoded.data(), encoded.data(), channels, 0, frames);
+		ReferenceAdpcm(reference.data(), encoded.data(), channels, frames);
+		CHECK(decoded == reference);
+
+		// A range starting mid block decodes the same samples.
+		std::vector<float> part(500 * channels);
+		maya::DecodeAdpcm(part.data(), encoded.data(), channels, 100, 500);
+		CHECK(std::equal(part.begin(), part.end(), reference.begin() + 100 * channels));
+	}
+}
+
+static void TestStorage()
+{
+	maya::AudioData audio;
+	audio.SampleRate = 48000;
+	audio.Channels = 2;
+	audio.Samples.resize(1000 * 2 + 2);
+	for (size_t i = 0; i < audio.Samples.size(); i++)
+		audio.Samples[i] = 0.5f * std::sin(i * 0.01f);
+	maya::AudioData original = audio;
+
+	// Int16 keeps every sample within one step, ADPCM within a few percent on a smooth wave.
+	for (maya::AudioStorage storage : { maya::INT16_STORAGE, maya::ADPCM_STORAGE }) {
+		maya::AudioData encoded = original;
+		encoded.SetStorage(storage);
+		CHECK(encoded.Storage == storage && encoded.Samples.empty());
+		CHECK(encoded.GetFrameCount() == 1001);
+
+		std::vector<float> out(1001 * 2);
+		CHECK(encoded.Decode(out.data(), 0, 1001) == 1001);
+		float error = 0;
+		for (size_t i = 0; i < out.size(); i++)
+			error = std::max(error, std::fabs(out[i] - original.Samples[i]));
+		CHECK(error <= (storage == maya::INT16_STORAGE ? 1.0f / 32768 : 0.05f));
+
+		// Reading past the end stops at the last frame.
+		CHECK(encoded.Decode(out.data(), 1000, 10) == 1);
+
+		encoded.SetStorage(maya::FLOAT_STORAGE);
+		CHECK(encoded.Storage == maya::FLOAT_STORAGE && encoded.Samples.size() == 1001 * 2);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	maya::CoreManager cm;
+
+	TestAdpcm();
+	TestStorage();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+#include <maya/core.hpp>
+#include <maya/dataio.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+// Block compression decoded back and compared to the source image.
+
+static int failures = 0;
+
+#define CHECK(cond) if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; failures++; }
+
+// Decode a BC4 style block of 8 bytes, used for BC3 alpha and the BC4 and BC5 channels.
+static int DecodeChannel(unsigned char const* block, int i)
+{
+	int a0 = block[0], a1 = block[1];
+	uint64_t bits = 0;
+	for (int k = 0; k < 6; k++)
+		bits |= static_cast<uint64_t>(block[2 + k]) << 8 * k;
+	int index = (bits >> 3 * i) & 7;
+	if (index < 2) return index ? a1 : a0;
+	if (a0 > a1) return ((8 - index) * a0 + (index - 1) * a1) / 7;
+	if (index < 6) return ((6 - index) * a0 + (index - 1) * a1) / 5;
+	return index == 6 ? 0 : 255;
+}
+
+// Decode channel k of a BC1 style block of 8 bytes.
+static int DecodeColor(unsigned char const* block, int i, int k)
+{
+	int c[2] = { block[0] | block[1] << 8, block[2] | block[3] << 8 };
+	int p[2];
+	for (int e = 0; e < 2; e++) {
+		int r = c[e] >> 11 & 31, g = c[e] >> 5 & 63, b = c[e] & 31;
+		p[e] = k == 0 ? r << 3 | r >> 2 : k == 1 ? g << 2 | g >> 4 : b << 3 | b >> 2;
+	}
+	int index = (block[4 + i / 4] >> 2 * (i % 4)) & 3;
+	if (index < 2) return p[index];
+	if (c[0] > c[1]) return index == 2 ? (2 * p[0] + p[1]) / 3 : (p[0] + 2 * p[1]) / 3;
+	return index == 2 ? (p[0] + p[1]) / 2 : 0;
+}
+
+static void TestBlockCompress()
+{
+	// Smooth gradients with edge blocks on both axes.
+	maya::ImageData image;
+	image.Size = { 33, 17 };
+	image.Channels = 4;
+	image.Data.resize(33 * 17 * 4);
+	for (int y = 0; y < 17; y++) {
+		for (int x = 0; x < 33; x++) {
+			unsigned char* p = &image.Data[(y * 33 + x) * 4];
+			p[0] = x * 7;
+			p[1] = y * 14;
+			p[2] = 128 + x - y;
+			p[3] = 255 - x * 3;
+		}
+	}
+
+	int const bw = 9, bh = 5;
+	for (maya::CompressedFormat format : { maya::BC1_FORMAT, maya::BC3_FORMAT, maya::BC4_FORMAT, maya::BC5_FORMAT }) {
+		int bytes = format == maya::BC1_FORMAT || format == maya::BC4_FORMAT ? 8 : 16;
+		maya::CompressedImageData compressed;
+		compressed.Encode(image, format, 3);
+		CHECK(compressed.Levels.size() == 1 && compressed.Levels[0].size() == static_cast<size_t>(bw * bh * bytes));
+		if (compressed.Levels.size() != 1)
+			continue;
+
+		int colorerror = 0, channelerror = 0;
+		for (int by = 0; by < bh; by++) {
+			for (int bx = 0; bx < bw; bx++) {
+				unsigned char const* block = &compressed.Levels[0][(by * bw + bx) * bytes];
+				for (int i = 0; i < 16; i++) {
+					int x = std::min(bx * 4 + i % 4, 32), y = std::min(by * 4 + i / 4, 16);
+					unsigned char const* p = &image.Data[(y * 33 + x) * 4];
+					switch (format) {
+						case maya::BC1_FORMAT:
+							for (int k = 0; k < 3; k++)
+								colorerror = std::max(colorerror, std::abs(DecodeColor(block, i, k) - p[k]));
+							break;
+						case maya::BC3_FORMAT:
+							channelerror = std::max(channelerror, std::abs(DecodeChannel(block, i) - p[3]));
+							for (int k = 0; k < 3; k++)
+								colorerror = std::max(colorerror, std::abs(DecodeColor(block + 8, i, k) - p[k]));
+							break;
+						case maya::BC4_FORMAT:
+							channelerror = std::max(channelerror, std::abs(DecodeChannel(block, i) - p[0]));
+							break;
+						case maya::BC5_FORMAT:
+							channelerror = std::max(channelerror, std::abs(DecodeChannel(block, i) - p[0]));
+							channelerror = std::max(channelerror, std::abs(DecodeChannel(block + 8, i) - p[1]));
+							break;
+					}
+				}
+			}
+		}
+		CHECK(colorerror <= 24);
+		CHECK(channelerror <= 4);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	maya::CoreManager cm;
+
+	TestBlockCompress();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+#include <maya/core.hpp>
+#include <maya/resampler.hpp>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <cmath>
+
+// Streaming resampling must not depend on how the input and output are split.
+
+static int failures = 0;
+
+#define CHECK(cond) if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond << std::endl; failures++; }
+
+static void TestResampler()
+{
+	for (maya::ResampleQuality quality : { maya::LOW_RESAMPLE, maya::MEDIUM_RESAMPLE, maya::HIGH_RESAMPLE }) {
+		unsigned const channels = 2, srcrate = 44100, dstrate = 48000;
+		size_t const frames = 20000;
+		std::vector<float> in(frames * channels);
+		for (size_t i = 0; i < frames; i++)
+			for (unsigned c = 0; c < channels; c++)
+				in[i * channels + c] = 0.5f * std::sin(i * 0.05f + c);
+
+		unsigned const outframes = 20000;
+		unsigned consumed = 0;
+		maya::Resampler whole(channels, srcrate, dstrate, quality);
+		std::vector<float> expected(outframes * channels);
+		unsigned wholeframes = whole.Process(expected.data(), outframes, in.data(), static_cast<unsigned>(frames), consumed);
+		CHECK(wholeframes == outframes);
+
+		// Random pieces of input and output must give the same samples as one call.
+		maya::Resampler pieces(channels, srcrate, dstrate, quality);
+		std::vector<float> out(outframes * channels);
+		std::mt19937 rng(1);
+		size_t inpos = 0, outpos = 0;
+		while (outpos < outframes && inpos < frames) {
+			unsigned want = static_cast<unsigned>(std::min<size_t>(rng() % 300 + 1, outframes - outpos));
+			unsigned give = static_cast<unsigned>(std::min<size_t>(rng() % 300, frames - inpos));
+			outpos += pieces.Process(out.data() + outpos * channels, want, in.data() + inpos * channels, give, consumed);
+			inpos += consumed;
+		}
+		CHECK(outpos == outframes);
+		bool same = true;
+		for (size_t i = 0; i < outpos * channels; i++)
+			same = same && std::fabs(out[i] - expected[i]) <= 1e-6f;
+		CHECK(same);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	maya::CoreManager cm;
+
+	TestResampler();
+
+	return failures ? 1 : 0;
+}